@@ -35,6 +35,15 @@ using namespace std;
 /// in a 45 BitBoard.
 typedef uint8_t bitrow_t;
 
+/// An attack map: the squares that each color's pieces attack (or defend), by
+/// shape and altogether.
+typedef struct attack_map
+{
+    bitboard_t shape[COLORS][SHAPES]; ///< Squares each color's pieces of each
+                                      ///< shape attack.
+    bitboard_t all[COLORS];           ///< Squares each color attacks.
+} attack_map_t;
+
 /// This class represents the board and generates moves.
 class board_base
 {
@@ -103,11 +112,15 @@ public:
     // These methods get information.
     virtual bool get_whose() const;
     virtual bitboard_t get_hash() const;
+    virtual bitboard_t get_pawn_hash() const;
     virtual int get_status(bool mate_test);
     virtual int get_num_moves() const;
     virtual unsigned get_num_pieces(const bool color) const;
+    virtual int get_shape(int x, int y) const;
     virtual value_t evaluate() const = 0; // Force sub-classes to override.
+    virtual value_t evaluate(value_t alpha, value_t beta) const;
     virtual bool check(bool off_move = false) const;
+    virtual void get_attack_map(attack_map_t& map) const;
     virtual bool zugzwang() const;
     virtual string to_string() const;
 
@@ -137,6 +150,7 @@ protected:
     static const bitboard_t squares_castle[COLORS][SIDES][REQS];
     static bitboard_t squares_adj_cols[8];
     static bitboard_t squares_pawn_attacks[COLORS][8][8];
+    static bitboard_t squares_unmap[ANGLES][15][256];
 
     // Zobrist hash keys:
     static bitboard_t key_piece[COLORS][SHAPES][8][8];
@@ -145,6 +159,12 @@ protected:
     static bitboard_t key_en_passant[8];
     static bitboard_t key_on_move;
 
+    // Material and piece-square scores and phase weights, which make() keeps
+    // summed up in the state (the evaluator fills these in):
+    static score_t value_piece[SHAPES];
+    static score_t value_square[COLORS][SHAPES][8][8];
+    static int value_phase[SHAPES];
+
     stateArray states;                            ///< Previous states.
     state_t state;                                  ///< Current state.
     bitBoardArray rotations[ANGLES][COLORS + 1];    ///< Previous rotated BitBoards.
@@ -160,6 +180,7 @@ protected:
     virtual void init_state();
     virtual void init_rotation();
     virtual void init_hash();
+    virtual void init_eval();
     virtual void precomp_key() const;
 
     // These methods generate moves.
@@ -173,10 +194,13 @@ protected:
     virtual void precomp_row() const;
     virtual void precomp_knight() const;
     virtual void precomp_pawn();
+    virtual void precomp_unmap() const;
 
     // These methods test for various conditions.
     virtual int mate();
     virtual bool check(bitboard_t b1, bool color) const;
+    virtual bitboard_t attacks_rook(int x, int y) const;
+    virtual bitboard_t attacks_bishop(int x, int y) const;
     virtual bool insufficient() const;
     virtual bool three() const;
     virtual bool fifty() const;
@@ -32,13 +32,34 @@ public:
     board_heuristic();
     ~board_heuristic();
     board_heuristic& operator=(const board_heuristic& that);
+    bool make(Move m);
     value_t evaluate() const;
+    value_t evaluate(value_t alpha, value_t beta) const;
+    value_t evaluate_uncached() const;
+    static void set_pawn_table_mb(int mb);
+    static int get_pawn_table_mb();
+    static void set_eval_table_mb(int mb);
+    static int get_eval_table_mb();
+    static void fit_tables(int pawn_mb, int eval_mb);
+    uint64_t get_eval_hits() const;
+    uint64_t get_eval_misses() const;
+    void reset_eval_counts();
+    static void set_lazy_eval(bool lazy);
+    static void set_attack_eval(bool attacks);
 
 private:
-    // The values of the pieces:
+    // A board owns its pawn and eval tables, so it can only be assigned, not copied.
+    board_heuristic(const board_heuristic& that);
+
+    // Each of the terms below carries a middlegame and an endgame score (see
+    // score_t), except for the tables of plain values, which say which phase
+    // they count in.
+
+    // The values of the pieces (middlegame and endgame alike):
     static const value_t value_material[SHAPES];
 
-    // The values of having different pieces on different squares:
+    // The values of having different pieces on different squares (middlegame
+    // and endgame alike):
     static const value_t value_position[SHAPES][8][8];
 
     // The values of having the white king on different squares during an
@@ -49,29 +70,48 @@ private:
     static const value_t value_king_middle[8][8];
     
     // The values of various pawn structure features:
-    static const value_t value_pawn_passed[8];
-    static const value_t value_pawn_doubled[9];
-    static const value_t value_pawn_isolated[9];
-    static const value_t value_pawn_doubled_isolated[9];
-    static const value_t value_pawn_duo;
+    static const score_t value_pawn_passed[8];
+    static const score_t value_pawn_doubled[9];
+    static const score_t value_pawn_isolated[9];
+    static const score_t value_pawn_doubled_isolated[9];
+    static const score_t value_pawn_duo;
 
-    //
+    // (Middlegame and endgame alike.)
     static const value_t value_knight_outpost[8][8];
 
     //
-    static const value_t value_bishop_over_knight;
-    static const value_t value_bishop_trapped;
+    static const score_t value_bishop_over_knight;
+    static const score_t value_bishop_trapped;
 
     //
-    static const value_t value_rook_on_7th;
-    static const value_t value_rooks_on_7th;
+    static const score_t value_rook_on_7th;
+    static const score_t value_rooks_on_7th;
+    static const score_t value_rook_open_file;
+    static const score_t value_rook_half_open_file;
 
     //
-    static const value_t value_queen_rook_on_7th;
-    static const value_t value_queen_offside;
+    static const score_t value_queen_rook_on_7th;
+    static const score_t value_queen_offside;
 
     // The penalty for giving up castling:
-    static const value_t value_king_cant_castle;
+    static const score_t value_king_cant_castle;
+
+    // The value of each square that a piece of each shape can safely move to,
+    // how much each shape's attacks on the squares around a king count, the
+    // penalty for the king by how much it's being attacked, the penalty for
+    // leaving a piece en prise, and whether to evaluate any of these at all:
+    static const score_t value_mobility[SHAPES];
+    static const int value_king_attacker[SHAPES];
+    static const score_t value_king_attacked[16];
+    static const score_t value_hanging;
+    static bool attack_eval;
+
+    // The most that the terms in evaluate_knights() ... evaluate_kings() can
+    // be worth for a piece of each color and shape on each square (worked out
+    // from the values above), and whether to stop evaluating once the rest of
+    // the terms can't bring the score back into the window:
+    static score_t value_lazy[COLORS][SHAPES][8][8];
+    static bool lazy_eval;
 
     //
     static bool precomputed_board_heuristic;
@@ -81,16 +121,36 @@ private:
     // Since pawn structure remains relatively static, we maintain a hash table
     // of previous pawn structure evaluations.  According to my tests, this hash
     // table sustains a hit rate of around 97%.  This enables us to perform
-    // sophisticated pawn structure analysis almost for free.
-    static PawnTable pawn_table;
-
-    value_t evaluate_pawns() const;
-    value_t evaluate_knights() const;
-    value_t evaluate_bishops() const;
-    value_t evaluate_rooks() const;
-    value_t evaluate_queens() const;
-    value_t evaluate_kings() const;
+    // sophisticated pawn structure analysis almost for free - and since each
+    // slot also keeps the passed pawns, pawn attacks, holes, and open files,
+    // the other pieces' pawn-dependent terms come almost for free too.
+    //
+    // Each board has a pawn table of its own (allocated the first time that
+    // the board is evaluated), and each search thread has a board of its own,
+    // so the threads never have to share - or lock - a pawn table.
+    static int pawn_table_mb;
+    static int pawn_table_mb_wanted;
+    mutable PawnTable *pawn_table;
+
+    // Positions recur too - by transposition, and from one iteration to the
+    // next - so we keep a (smaller) hash table of previous evaluations of whole
+    // positions, one per board like the pawn table.
+    static int eval_table_mb;
+    static int eval_table_mb_wanted;
+    mutable EvalTable *eval_table;
+
+    value_t evaluate_terms(value_t alpha, value_t beta, bool *exact) const;
+    score_t evaluate_pawns(pawn_slot_t& pawns) const;
+    score_t evaluate_knights(const pawn_slot_t& pawns) const;
+    score_t evaluate_bishops(const pawn_slot_t& pawns) const;
+    score_t evaluate_rooks(const pawn_slot_t& pawns) const;
+    score_t evaluate_queens() const;
+    score_t evaluate_kings(const pawn_slot_t& pawns) const;
+    score_t evaluate_attacks() const;
     void precomp_pawn();
+    void precomp_value() const;
+    static void precomp_lazy();
+    static score_t magnitude(score_t s);
 };
 
 #endif
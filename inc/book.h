@@ -26,9 +26,9 @@
 #include <fstream>
 #include <string>
 #include <list>
+#include <map>
 
 #include "move.h"
-#include "table.h"
 #include "board_base.h"
 
 // Token types:
@@ -55,18 +55,19 @@
 class book
 {
 public:
-    book(table *t, std::string file_name, int n);
+    book(std::string file_name, int n);
     void read();
+    bool probe(bitboard_t hash, Move *move_ptr) const;
 
 private:
     int num_moves;                       ///<
     std::list<std::list<Move> > games; ///< Game list.
+    std::map<bitboard_t, Move> table;    ///< Book move for each position.
 
     board_base *board_ptr;               ///< Board representation object.
-    table *table_ptr;                    ///< Transposition table object.
 
     // Based on the PGN file, the following methods populate the token list,
-    // game list, and transposition table.
+    // game list, and book move table.
     void populate_tokens(std::istream& stream, std::list<std::string>& tokens);
     void populate_games(std::list<std::string>& tokens);
     void populate_table();
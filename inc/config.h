@@ -37,15 +37,29 @@
 // Default move search engine - must be "MTD(f)":
 #define SEARCH_ENGINE   "MTD(f)"
 
+// Default parallel search mode - "shared", "ybwc" or "root":
+#define SMP_MODE        "shared"
+
 // Default opening book file name:
 #define BOOK_NAME       "book.pgn"
 
+// Seed for the Zobrist hash keys.  Transposition table files record it, so
+// changing it makes them useless:
+#define KEY_SEED        0x2545F4914F6CDD1DULL
+
 // All of the default values in this section must be >= 1.
 #define XPOS_TABLE_MB      128  // Transposition table size (in MB).
 #define PAWN_TABLE_MB       16  // Pawn table size (in MB).
+#define EVAL_TABLE_MB        4  // Eval table size (in MB).
 #define BOOK_MOVES          10  // Num moves to read per game in book (in plies).
 #define OVERHEAD             1  // Move search overhead (in centiseconds).
 #define MAX_DEPTH           48  // Maximum search depth (in plies).
+#define SEARCH_THREADS       1  // Number of search threads.
+#define MAX_THREADS         64  // Maximum number of search threads.
+#define MULTI_PV             1  // Number of lines to report when analyzing.
+#define SPLIT_MIN_DEPTH      4  // Don't split nodes with fewer plies than this left.
+#define CACHE_LINE          64  // Cache line size (in bytes).
+#define BUCKET_SLOTS         4  // Transposition table slots per cache line.
 
 //NOT a theoretical max because pawn can make many queens
 //but this should be sufficient for most circumstances
@@ -58,6 +72,7 @@
 #define SPECIAL_SEARCH_DEPTH 5  // search X plys deeper for captures, etc. (odd number)
 #define R                    1  // Null move pruning depth reduction factor (in plies).
 #define NMP_PIECE_LIMIT     15  // fewer than X = don't do null move pruning
+#define KILLER_SLOTS         2  // Number of killer moves remembered per ply.
 
 
 
@@ -77,6 +92,15 @@
 //
 #define VALUE_CONTEMPT      0 // How much we hate our opponent.
 
+// How much each piece counts towards the game phase.  The evaluation is blended
+// from its middlegame score (with all of the pieces on the board, the phase is
+// PHASE_MAX) to its endgame score (with only kings and pawns left, it's 0).
+#define PHASE_KNIGHT        1
+#define PHASE_BISHOP        1
+#define PHASE_ROOK          2
+#define PHASE_QUEEN         4
+#define PHASE_MAX          24
+
 
 
 /*----------------------------------------------------------------------------*\
@@ -97,6 +121,10 @@
 #error "In inc/config.h, PAWN_TABLE_MB must be >= 1."
 #endif
 
+#if EVAL_TABLE_MB < 1
+#error "In inc/config.h, EVAL_TABLE_MB must be >= 1."
+#endif
+
 #if BOOK_MOVES < 1
 #error "In inc/config.h, BOOK_MOVES must be >= 1."
 #endif
@@ -109,6 +137,10 @@
 #error "In inc/config.h, MAX_DEPTH must be >= 1."
 #endif
 
+#if BUCKET_SLOTS < 2
+#error "In inc/config.h, BUCKET_SLOTS must be >= 2."
+#endif
+
 // Piece colors:
 #define WHITE       0
 #define BLACK       1
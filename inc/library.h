@@ -55,6 +55,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 
 // POSIX data types:
@@ -93,6 +94,7 @@ typedef struct                        // Condition variable.
 int thread_create(thread_t *thread, entry_t entry, void *arg);
 int thread_wait(thread_t *thread);
 int thread_destroy(thread_t *thread);
+int thread_cpus();
 
 // Function prototypes related to mutexes:
 int mutex_create(mutex_t *mutex);
@@ -108,14 +110,22 @@ int cond_signal(cond_t *cond);
 int cond_broadcast(cond_t *cond);
 int cond_destroy(cond_t *cond);
 
+// Function prototypes related to memory:
+void *memory_alloc(size_t size, bool interleave = false);
+void memory_free(void *ptr, size_t size);
+void memory_clear(void *ptr, size_t size);
+void *memory_map_file(const char *path, size_t size, bool *created);
+
 // Function prototypes related to timers:
 int timer_function(void (*function)(void *), void *data);
 int timer_set(int csec);
 int timer_cancel();
+uint64_t timer_now();
 
 // Function prototypes related to 64-bit pseudo-random number generation and
 // bitwise operations:
 uint64_t rand_64();
+uint64_t rand_64(uint64_t *state);
 int count_64(uint64_t n);
 int find_64(uint64_t n);
 int find_32(uint32_t n);
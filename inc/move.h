@@ -28,6 +28,28 @@
 
 typedef int16_t value_t;
 
+/// A pair of scores - one for the middlegame, one for the endgame - packed into
+/// one integer, so that the evaluator can add both up at once and only blend
+/// them (according to the game phase) at the very end.  The middlegame score
+/// is in the low 16 bits and the endgame score in the high 16 bits.
+typedef int32_t score_t;
+
+inline score_t SCORE(int mg, int eg)
+{
+    return (score_t) ((uint32_t) eg << 16) + mg;
+}
+
+inline value_t SCORE_MG(score_t s)
+{
+    return (value_t) (uint16_t) s;
+}
+
+inline value_t SCORE_EG(score_t s)
+{
+    // Round, since a negative middlegame score borrows from the endgame one.
+    return (value_t) (uint16_t) ((uint32_t) (s + 0x8000) >> 16);
+}
+
 /// This class contains the from and to coordinates, the pawn promotion information, 
 /// and the MiniMax score.  We use a BitField to tightly pack this information 
 /// into 32 bits because some of our methods return this structure (rather 
@@ -29,6 +29,7 @@
 #include "clock.h"
 #include "board_base.h"
 class xboard;
+class book;
 
 // Search statuses:
 #define IDLING          0 // Idling (doing nothing)
@@ -38,22 +39,36 @@ class xboard;
 #define QUITTING        4 // Terminating search thread.
 #define SEARCH_STATS    5
 
+// Parallel search modes:
+#define SMP_SHARED      0 // Helpers search the whole tree, sharing the table.
+#define SMP_YBWC        1 // Helpers search sibling moves at split points.
+#define SMP_ROOT        2 // Every thread searches its own root moves.
+#define SMP_MODES       3
+
 /// Move search base.
 class search_base
 {
 public:
-    search_base(table *t, history *h, chess_clock *c, xboard *x);
+    search_base(table *t, history *h, chess_clock *c, xboard *x, int id = 0);
     virtual ~search_base();
     virtual search_base& operator=(const search_base& that);
     virtual Move get_hint() const;
     virtual thread_t get_thread() const;
+    virtual int get_status() const;
     virtual void set_depth(int d);
     virtual void set_output(bool o);
+    virtual void set_multipv(int n);
+    virtual void set_threads(int n);
+    virtual int get_threads() const;
+    virtual void set_smp_mode(int m);
+    virtual void set_memory(int mb);
+    virtual void set_book(book *b);
+    virtual void wait_idle();
     virtual void move_now();
     virtual void verify_prediction(Move m);
     virtual void change(int s, const board_base &now);
     static std::string status_to_string(int status);
-    void reset();
+    virtual void reset();
 
 #ifdef DEBUG_SEARCH
     static string debug_pv, debug_mv, debug_pv_prefix;
@@ -67,21 +82,29 @@ protected:
     virtual void start();                      ///< C++ thread entry point.
     virtual bool iterate(int s) = 0;           ///< Force sub-classes to override.
     virtual void extract_pv();                 ///<
+    virtual void shift_pv();                   ///<
     virtual void extract_hint(int s);          ///<
 
     MoveArray pv;         ///< Principal variation.
+    bitboard_t pv_hashes[MAX_DEPTH]; ///< Hash keys of the positions along it.
     Move hint;            ///< Opponent's best move.
     int max_depth;          ///< Maximum search depth.
     int nodes;              ///< Number of nodes searched.
     bool output;            ///< Whether to print thinking output.
+    int multipv;            ///< Number of lines to report when analyzing.
     int correct_guesses;    ///<
     int total_guesses;      ///<
+    int thread_id;          ///< 0 for the main search, 1 and up for helpers.
+    int num_threads;        ///< Number of search threads (including ours).
+    int memory_mb;          ///< Memory for the hash tables (in MB), or 0 if
+                            ///< we haven't been given a budget.
 
     board_base *board_ptr;  ///< Board representation object.
     table *table_ptr;       ///< Transposition table object.
     history *history_ptr;   ///< History table object.
     chess_clock *clock_ptr; ///< Chess clock object.
     xboard *xboard_ptr;     ///< Chess Engine Communication Protocol object.
+    book *book_ptr;         ///< Opening book object.
 
     mutex_t timeout_mutex;  ///< The lock that protects...
     bool inBook;            ///< ...the flag that says to check book or not
@@ -93,6 +116,8 @@ protected:
     thread_t search_thread; ///< ...the search thread via...
     int search_status;      ///< ...the search status!  :-D
     int token_update;       ///< Whether there are there unprocessed requests.
+    bool searching;         ///< Whether the search thread is in iterate().
+    cond_t idle_cond;       ///< Signalled when the search thread goes idle.
 
     // Prevent the class from being instantiated without the proper
     // construction.
@@ -28,6 +28,51 @@
 #include "clock.h"
 #include "xboard.h"
 
+// Move ordering priorities (the history heuristic fills in below these):
+#define ORDER_HASH      VALUE_KING                    // Best move from a previous iteration.
+#define ORDER_KILLER    (ORDER_HASH - 1)              // Killer moves (one less per slot).
+#define ORDER_COUNTER   (ORDER_KILLER - KILLER_SLOTS) // Refutation of the opponent's move.
+
+// How many of a node's moves that failed to cause a cutoff we remember, to
+// lower their history scores once some other move does.
+#define HISTORY_TRIED   32
+
+// Late move reductions: a quiet move that comes after the first LMR_MOVES at a
+// node, with at least LMR_DEPTH plies left to search and no good history, is
+// searched a ply shallower first - and only searched fully if it fails high.
+#define LMR_MOVES        3
+#define LMR_DEPTH        3
+
+/// Split point: a node whose younger brothers are being searched in parallel
+/// (Young Brothers Wait).
+typedef struct split_point
+{
+    board_base *board;          ///< Position at the split point.
+    MoveArray *moves;           ///< The owner's move list.
+    unsigned next;              ///< Index of the next move to hand out.
+    int depth;                  ///< Ply of the split point.
+    int reduction;              ///< Plies that its search has been reduced by.
+    int max_depth;              ///< Depth of the owner's iteration.
+    bool in_check;              ///< Whether the color on move is in check.
+    bool ranked;                ///< Whether every move gets a full window
+                                ///< (and therefore an exact score).
+    value_t alpha;              ///< Lower bound (raised as moves come back).
+    value_t beta;               ///< Upper bound.
+    Move best;                  ///< Best move so far.
+    bool best_quiet;            ///< Whether it's quiet (no capture or promo).
+    Move tried[HISTORY_TRIED];  ///< Moves that have failed to cause a cutoff
+    int num_tried;              ///< (and how many of them there are).
+    bool cutoff;                ///< Whether a move has failed high.
+    int workers;                ///< Threads (owner included) working here.
+    Move pv[MAX_DEPTH];         ///< Best move's line (from the split ply on).
+    int pv_length;              ///< Ply just past the end of that line.
+    Move line[MAX_DEPTH];       ///< Moves made to get here (up to the split
+    int line_piece[MAX_DEPTH];  ///< ply), and their piece-square indices.
+    struct split_point *parent; ///< Split point the owner is working for.
+    mutex_t mutex;              ///< The lock that protects the above.
+    cond_t cond;                ///< Signalled when the last worker leaves.
+} split_point_t;
+
 /// MTD(f) move search.
 class search_mtdf : public search_base
 {
@@ -35,14 +80,78 @@ public:
     search_mtdf(table* t, history* h, chess_clock* c, xboard* x);
     ~search_mtdf();
     search_mtdf& operator=(const search_mtdf& that);
+    void reset();
+    void set_threads(int n);
+    int get_threads() const;
+    void set_smp_mode(int m);
 private:
+    search_mtdf(search_mtdf* m, int id);
+    search_mtdf* master;                     ///< Main search (maybe us).
+    search_mtdf* helpers[MAX_THREADS];       ///< Helper searches (from 1).
+    int threads_wanted;                      ///< Search threads asked for.
+    int smp_mode;                            ///< How the threads share work.
+    split_point_t splits[MAX_DEPTH];         ///< Our split points, by ply.
+    split_point_t* active_split;             ///< Split point we work for.
+    MoveArray root_moves;                    ///< Legal root moves, ranked.
+    unsigned root_order[MAX_MOVES_PER_TURN]; ///< Their indices in the root
+                                             ///< move list.
+    Move root_pv[MAX_MOVES_PER_TURN][MAX_DEPTH]; ///< Each root move's line.
+    int root_pv_length[MAX_MOVES_PER_TURN];  ///< Each root line's length.
+    Move pv_table[MAX_DEPTH][MAX_DEPTH];     ///< Triangular PV table: the
+                                             ///< best line from each ply.
+    int pv_length[MAX_DEPTH];                ///< Ply just past the end of
+                                             ///< each of those lines.
+    int lines;                               ///< Lines to search for (and
+                                             ///< report) this search.
+    mutex_t pool_mutex;                      ///< The lock that protects...
+    cond_t pool_cond;                        ///< ...the condition that wakes
+                                             ///< idle workers, and...
+    split_point_t* pool[MAX_THREADS * MAX_DEPTH]; ///< ...the open split
+    int pool_size;                           ///< points, and...
+    int idle_workers;                        ///< ...the number of idle
+                                             ///< workers!  :-D
     MoveArray* MoveArrays;
+    Move line[MAX_DEPTH];                    ///< Move made at each ply.
+    int line_piece[MAX_DEPTH];               ///< Its piece-square index (or
+                                             ///< -1 if it's a null move).
+    Move killers[MAX_DEPTH][KILLER_SLOTS];   ///< Moves that caused cutoffs at
+                                             ///< each ply.
+    Move countermoves[COLORS][64][64];       ///< Moves that refuted the
+                                             ///< opponent's from/to squares.
+    void init();
+    void clear_killers();
+    void store_cutoff(int depth, int horizon, bool whose, Move m, bool quiet,
+                      const Move *tried = NULL, int num_tried = 0);
+    void adjust_helpers();
+    void start_helpers();
+    void stop_helpers();
+    int helper_nodes() const;
+    int eval_hits() const;
+    void help();
+    void work();
+    bool stopped() const;
+    bool make(int depth, Move m);
+    int piece_square(Move m) const;
+    int history_score(int depth, bool whose, Move m) const;
+    bool can_split(int depth) const;
+    Move split(int depth, int reduction, unsigned first, value_t alpha,
+               value_t beta,
+               Move best, bool in_check, bool ranked = false,
+               const Move *tried = NULL, int num_tried = 0);
+    void rank_root_moves();
+    void update_pv(int depth, Move m);
+    void save_root_pv(unsigned index, Move m);
+    void extract_pv();
+    value_t multipv_alpha(unsigned searched) const;
+    void print_lines(int depth);
+    void search_split(split_point_t* sp);
     bool iterate(int s);  //false if we used a book move
     //Move mtdf(int depth, value_t guess = 0);
     Move minimax(int depth, value_t alpha = -INFINITY, 
                    value_t beta = +INFINITY, 
                    bool specialCase = true,
-                   bool try_null_move = true);
+                   bool try_null_move = true,
+                   int reduction = 0);
     //value_t quiesce(int shallowness, value_t alpha, value_t beta);
     void useBook(bool yesno); //turn book on or off
 };
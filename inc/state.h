@@ -23,12 +23,15 @@
 #define STATE_H
 
 #include "config.h"
+#include "move.h"
 
 /// This structure describes the entire state of the board.  
 
 /// This structure contains the 12 BitBoards needed to represent the state of
 /// the board along with castling statuses, en passant vulnerability, the color
-/// on move, and the 50 move rule counter.
+/// on move, and the 50 move rule counter - and, so that the evaluator needn't
+/// add them up at every leaf, each color's material and piece-square scores
+/// and the game phase.
 ///
 /// Subtle!  In the en passant vulnerability field, we need only store the file
 /// of the pawn susceptible to en passant.  Its rank is implied by the color on
@@ -44,6 +47,11 @@ typedef struct state
     bool on_move;                     ///< Color on move.
     int fifty;                        ///< 50 move rule counter.
     int pieceCount;
+    score_t material[COLORS];         ///< Material scores.
+    score_t position[COLORS];         ///< Piece-square scores.
+    int phase;                        ///< Game phase (PHASE_MAX with all
+                                      ///< of the pieces on the board, down
+                                      ///< to 0 with only kings and pawns).
 } state_t;
 
 class stateArray
@@ -60,6 +68,13 @@ public:
 	}
 	inline void clear(){mNumElements = 0;}
 	inline void removeLast(){mNumElements--;}
+	inline stateArray& operator=(const stateArray& rhs)
+	{
+		for (unsigned i = 0; i < rhs.mNumElements; ++i)
+			states[i] = rhs.states[i];
+		mNumElements = rhs.mNumElements;
+		return *this;
+	}
 };
 
 /// This macro assembles a BitBoard that contains all of a color's pieces.
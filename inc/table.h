@@ -22,6 +22,9 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+// C++ stuff:
+#include <string>
+
 // Default Gray Matter stuff:
 #include "config.h"
 #include "library.h"
@@ -42,114 +45,361 @@
  |                            Transposition Table                             |
 \*----------------------------------------------------------------------------*/
 
-/// Transposition table slot.
-#pragma pack(1)
+/// Transposition table slot.  Several search threads share the table without
+/// locks, so a slot's two words can be torn by concurrent writers.  We store
+/// the hash key XORed with the data word; a reader recomputes the key from the
+/// two words it read, and a torn slot simply fails to match.
 typedef struct xpos_slot
 {
-    bitboard_t hash;                   ///< Zobrist hash key.           64 bits
-    int16_t depth;                     ///< Depth of our search.     +  16 bits
-    int16_t type;                      ///< Upper, exact, or lower.  +  16 bits
-    Move move;                         ///< Best move and score.     +  32 bits
+    volatile uint64_t check;           ///< Hash key ^ data.            64 bits
+    volatile uint64_t data;            ///< Move, depth, type, age.  +  64 bits
 } xpos_slot_t;                         //                            = 128 bits
-#pragma pack()
+
+/// Transposition table bucket: as many slots as fit in a cache line.  The first
+/// DEPTH_SLOTS slots are depth-preferred: they keep the most valuable (deepest,
+/// freshest) results, so that results near the root survive heavy tactical
+/// searches.  The last slot is always-replace: it takes whatever the
+/// depth-preferred slots turn away, so that the shallow results that are
+/// probed most often still get a home.
+#define DEPTH_SLOTS (BUCKET_SLOTS - 1)
+typedef struct xpos_bucket
+{
+    xpos_slot_t slot[BUCKET_SLOTS];    ///< The slots.               4 x 128 bits
+} xpos_bucket_t;                       //                            = 512 bits
+
+/// Transposition table file header.  A file-backed table starts with a page
+/// holding this header, followed by the buckets.  We only trust a file whose
+/// header matches our own build: the same layout, the same hash keys, and the
+/// same number of buckets.  Every process that maps the file shares its
+/// generations: each new search takes the next generation from the header
+/// with an atomic increment, and every slot's age is measured against the
+/// header's generation, so processes see each other's slots as live.
+#define XPOS_FILE_MAGIC   "GRAYXPOS"
+#define XPOS_FILE_VERSION 1
+#define XPOS_HEADER_SIZE  4096
+typedef struct xpos_header
+{
+    char magic[8];                     ///< XPOS_FILE_MAGIC.
+    uint32_t version;                  ///< XPOS_FILE_VERSION.
+    uint32_t bucket_size;              ///< sizeof(xpos_bucket_t).
+    uint64_t key_seed;                 ///< KEY_SEED.
+    uint64_t buckets;                  ///< The number of buckets.
+    uint16_t generation;               ///< The latest search's generation.
+    uint16_t cleared;                  ///< When the table was last cleared.
+    uint16_t wiped;                    ///< When the table was last wiped.
+} xpos_header_t;
+
+/// How many plies of depth one search's worth of age costs a slot when we're
+/// choosing which slot to evict.
+#define AGE_PLIES   4
+
+/// How many slots to sample when estimating how full the table is.
+#define HASHFULL_SAMPLE 1000
 
 /// Transposition table.
 class table
 {
 public:
-    table(int mb = XPOS_TABLE_MB);
+    table(int mb = XPOS_TABLE_MB, bool interleave = false,
+          std::string file = "");
     ~table();
+    void resize(int mb);
+    int get_mb() const;
     inline void clear()
     {
-        for (uint64_t index = 0; index < slots; index++)
-        {
-            data[index].hash = 0;
-            data[index].depth = 0;
-            data[index].type = USELESS;
-            data[index].move.set_null();
-            data[index].move.value = 0;
-        }
+      /// Forget every slot.  Rather than wiping the table, start a new
+      /// generation and treat every slot from before it as empty.  (A table
+      /// backed by a file is meant to accumulate results across games and
+      /// processes, so for it, just start a new generation - its old slots
+      /// will be the first to go.)
+      uint16_t g = next_generation();
+      if (header == NULL)
+        gen->cleared = g;
+    }
+
+    inline void new_search()
+    {
+      /// Start a new generation, so that slots from previous searches become
+      /// the first to be evicted.  Slot ages are only exact while every slot
+      /// was written within the last 2^16 generations, so every 2^15 searches,
+      /// wipe the table for real.  (Only one of the processes sharing a file
+      /// can draw that generation, so only one of them wipes it.)
+      uint16_t g = next_generation();
+      if ((uint16_t) (g - gen->wiped) == 0x8000)
+      {
+        memory_clear((void *) data, (size_t) buckets * sizeof(xpos_bucket_t));
+        gen->wiped = gen->cleared = g;
+      }
+    }
+
+    int hashfull() const;
+
+    inline void prefetch(bitboard_t hash) const
+    {
+      /// We're about to probe for this position.  Start fetching its bucket
+      /// into cache now, so that we needn't wait for it then.
+#if defined(__GNUC__)
+      __builtin_prefetch((const void *) bucket(hash));
+#endif
     }
 
-    inline bool probe(bitboard_t hash, int depth, int type, Move *move_ptr)
+    inline bool probe(bitboard_t hash, int depth, Move *move_ptr)
     {
-      uint64_t index = hash%slots;
+      /// Look for this position in its bucket.  If we've already searched it
+      /// deeper than the specified depth, then save its move (and score) to
+      /// the memory pointed to by move_ptr and return success.  If we've only
+      /// searched it shallower, then still save its move (it's the best one
+      /// to try first) but return failure.  Either way, the slot's still
+      /// useful, so bring it into the current generation.
+      xpos_slot_t *slot = bucket(hash)->slot;
 
-      if (data[index].hash == hash)
+      for (int j = 0; j < BUCKET_SLOTS; j++)
       {
-          if (data[index].depth > depth)
+        uint64_t d = slot[j].data;
+        if ((slot[j].check ^ d) == hash && slot_live(d))
+        {
+          if (slot_generation(d) != gen->generation)
           {
-              //we've already searched this node
-              //the the specified depth or greater, so just
-              //return the move
-              *move_ptr = data[index].move;
-              return true;
+            d = slot_refresh(d);
+            slot[j].check = hash ^ d;
+            slot[j].data = d;
           }
+          *move_ptr = slot_move(d);
+          return slot_depth(d) > depth;
+        }
       }
       return false;
     }
 
-
     inline void store(bitboard_t hash, int depth, int type, Move& move)
     {
-      uint64_t index = hash%slots;
+      /// Save this position's move (and score) in its bucket.  If the position
+      /// is already in a depth-preferred slot from this search, then only
+      /// overwrite it with a deeper search (a shallower one goes to the
+      /// always-replace slot instead).  If not, then it goes to the least
+      /// valuable depth-preferred slot - an empty one, or else the one with
+      /// the least depth left once its age is charged against it - provided
+      /// that it's worth at least as much.  Otherwise, it goes to the
+      /// always-replace slot.  (That goes for a position that's already in
+      /// the always-replace slot, too: if it's now worth a depth-preferred
+      /// slot, then promote it, and empty the always-replace slot.)
+      xpos_slot_t *slot = bucket(hash)->slot;
+      int victim = 0, victim_worth = 0;
 
-      //overwrite if same board and deeper 
-      //or in conflict
-      if ((data[index].hash != hash) ||
-            (depth > data[index].depth))
+      for (int j = 0; j < BUCKET_SLOTS; j++)
+      {
+        uint64_t d = slot[j].data;
+        if ((slot[j].check ^ d) == hash && slot_live(d))
         {
-          data[index].hash = hash;
-          data[index].depth = depth;
-          data[index].type = type;
-          data[index].move = move;
-          return;
+          if (j >= DEPTH_SLOTS && depth >= victim_worth)
+          {
+            slot[j].check = slot[j].data = 0;
+            break;
+          }
+          victim = j;
+          if (j < DEPTH_SLOTS && depth < slot_depth(d) &&
+              slot_generation(d) == gen->generation)
+            victim = DEPTH_SLOTS;
+          victim_worth = -(1 << 30);
+          break;
+        }
+        if (j >= DEPTH_SLOTS)
+          continue;
+        int worth = slot_worth(d);
+        if (!j || worth < victim_worth)
+        {
+          victim = j;
+          victim_worth = worth;
         }
+      }
+      if (depth < victim_worth)
+        victim = DEPTH_SLOTS;
+
+      uint64_t d = slot_pack(depth, type, move);
+      slot[victim].check = hash ^ d;
+      slot[victim].data = d;
     }
 
 private:
-    uint64_t slots;      ///< The number of slots.
-    xpos_slot_t *data;   ///< The slots themselves.
+    uint64_t buckets;      ///< The number of buckets.
+    xpos_bucket_t *data;   ///< The buckets themselves.
+    bool interleave;       ///< Whether to spread the buckets across NUMA nodes.
+    std::string file;      ///< The file backing the buckets, if any.
+    xpos_header_t *header; ///< The file's header (or NULL, if no file).
+    xpos_header_t own;     ///< Our generations, if there's no file.
+    volatile xpos_header_t *gen; ///< The generations in use: file's or own.
+
+    void allocate(int mb);
+    bool map_file(uint64_t buckets);
+    void release();
+    static uint64_t buckets_for(int mb);
+
+    inline xpos_bucket_t *bucket(bitboard_t hash) const
+    {
+      /// Find this position's bucket.  Scale the hash key down to the number
+      /// of buckets (multiply, then keep the high half), so that the number
+      /// of buckets needn't be a power of 2 and we can use all of the memory
+      /// that we were given.
+#if defined(__SIZEOF_INT128__)
+      return &data[(uint64_t) (((unsigned __int128) hash * buckets) >> 64)];
+#else
+      return &data[hash % buckets];
+#endif
+    }
+
+    inline uint16_t next_generation()
+    {
+      /// Start a new generation and return it.  The increment is atomic, since
+      /// other processes may be starting searches on the same file.
+      return __sync_add_and_fetch(&gen->generation, 1);
+    }
+
+    inline uint64_t slot_pack(int depth, int type, Move& move) const
+    {
+      /// Pack a move (with its score), a depth, a type, and the current
+      /// generation into one data word: the move's coordinates and promotion
+      /// in bits 0-14, its score in bits 16-31, the depth in bits 32-39, the
+      /// type in bits 40-47, and the generation in bits 48-63.
+      return (uint64_t) (move.x1 | move.y1 << 3 | move.x2 << 6 | move.y2 << 9 |
+                         move.promo << 12) |
+             (uint64_t) (uint16_t) move.value << 16 |
+             (uint64_t) (uint8_t) depth << 32 |
+             (uint64_t) (uint8_t) type << 40 |
+             (uint64_t) gen->generation << 48;
+    }
+
+    inline uint64_t slot_refresh(uint64_t d) const
+    {
+      return (d & 0x0000FFFFFFFFFFFFULL) | (uint64_t) gen->generation << 48;
+    }
+
+    inline bool slot_live(uint64_t d) const
+    {
+      /// A slot is live if it isn't useless and it's been written since we
+      /// last cleared the table.
+      return slot_type(d) != USELESS &&
+             (uint16_t) (gen->generation - slot_generation(d)) <=
+             (uint16_t) (gen->generation - gen->cleared);
+    }
+
+    inline int slot_worth(uint64_t d) const
+    {
+      /// An empty slot is worth less than any live one, however stale.
+      if (!slot_live(d))
+        return -(1 << 30);
+      return slot_depth(d) -
+             AGE_PLIES * (uint16_t) (gen->generation - slot_generation(d));
+    }
+
+    static inline Move slot_move(uint64_t d)
+    {
+      Move move;
+      move.x1 = d & 7;
+      move.y1 = d >> 3 & 7;
+      move.x2 = d >> 6 & 7;
+      move.y2 = d >> 9 & 7;
+      move.promo = d >> 12 & 7;
+      move.value = (int16_t) (d >> 16);
+      return move;
+    }
+
+    static inline int slot_depth(uint64_t d) { return (int8_t) (d >> 32); }
+    static inline int slot_type(uint64_t d) { return (uint8_t) (d >> 40); }
+    static inline uint16_t slot_generation(uint64_t d) { return d >> 48; }
 };
 
 /*----------------------------------------------------------------------------*\
  |                               History Table                                |
 \*----------------------------------------------------------------------------*/
 
-/// History table.
+/// The most a history score can reach (in either direction).  This must stay
+/// below the move ordering values reserved for hash moves, killers and
+/// countermoves.
+#define HISTORY_MAX 8192
+
+/// How many plies back the continuation history looks: at our opponent's last
+/// move, and at our own move before that.
+#define CONT_PLIES  2
+
+/// History table.  For each color and each pair of from and to squares, how
+/// well a move has done lately: raised each time it causes a cutoff, and
+/// lowered each time another move causes the cutoff instead.
+///
+/// Alongside it, the continuation history keeps the same sort of score for
+/// each pair of moves one (and two) plies apart.  There, a move is keyed by
+/// its piece-square index - the shape of the piece moved times 64, plus the
+/// square that it moved to - since a good reply has more to do with which
+/// piece just went where than with where it came from.
 class history
 {
 public:
     history();
     ~history();
     void clear();
+    void age();
     inline int probe(bool color, Move m) const
     {
-      //returns the depth at which this move is still considered the best
-      return data[color][m.x1][m.y1][m.x2][m.y2];  
+      return data[color][m.x1 + 8 * m.y1][m.x2 + 8 * m.y2];
     };
-    
-    inline void store(bool color, Move m) //, int depth)
+
+    inline void store(bool color, Move m, int bonus)
+    {
+      /// Add a bonus (or, if it's negative, a malus) to the move's score.
+      gravity(data[color][m.x1 + 8 * m.y1][m.x2 + 8 * m.y2], bonus);
+    }
+
+    inline int probe_cont(int ply, bool color, int prev, int next) const
     {
-      // mark this as a good move
-      data[color][m.x1][m.y1][m.x2][m.y2] = m.value;
+      /// Look up how well the move with piece-square index next has done
+      /// the specified number of plies after the one with index prev.
+      return cont[ply - 1][color][prev][next];
+    }
+
+    inline void store_cont(int ply, bool color, int prev, int next, int bonus)
+    {
+      /// Add a bonus (or a malus) to that score.
+      gravity(cont[ply - 1][color][prev][next], bonus);
     }
 private:
-    int *****data;
+    int data[COLORS][64][64];                   ///< Score for each color,
+                                                ///< from, and to.
+    int (*cont)[COLORS][SHAPES * 64][SHAPES * 64]; ///< Score for each ply
+                                                ///< back, color, previous
+                                                ///< and next piece-square.
+
+    static inline void gravity(int& score, int bonus)
+    {
+      /// The closer the score already is to HISTORY_MAX in the bonus's
+      /// direction, the less of the bonus it gets, so the score never leaves
+      /// the range - and a move that was good long ago can be overtaken
+      /// quickly.
+      bonus = bonus > HISTORY_MAX ? HISTORY_MAX :
+              bonus < -HISTORY_MAX ? -HISTORY_MAX : bonus;
+      score += bonus - score * (bonus < 0 ? -bonus : bonus) / HISTORY_MAX;
+    }
 };
 
 /*----------------------------------------------------------------------------*\
  |                                 Pawn Table                                 |
 \*----------------------------------------------------------------------------*/
 
-/// Pawn table slot.
-#pragma pack(1)
+/// Pawn table slot: everything that we know about a pawn structure, so that
+/// the rest of the evaluator needn't work it out again from the BitBoards.
+/// It's exactly one cache line.  (The files are one bit each, file A in bit 0.)
 typedef struct pawn_slot
 {
-    bitboard_t hash;                   ///< Zobrist hash key.    64 bits
-    value_t value;                     ///< Score.             + 16 bits
-} pawn_slot_t;                          //                      = 80 bits
-#pragma pack()
+    bitboard_t hash;            ///< Zobrist hash key.             64 bits
+    bitboard_t passed[COLORS];  ///< Each color's passed pawns.  + 128 bits
+    bitboard_t attacks[COLORS]; ///< Squares each color's pawns  + 128 bits
+                                ///< attack.
+    bitboard_t holes[COLORS];   ///< Squares each color's pawns  + 128 bits
+                                ///< can never attack.
+    score_t value;              ///< Score (for white).          +  32 bits
+    uint8_t half_open[COLORS];  ///< Files without any pawns of  +  16 bits
+                                ///< each color.
+    uint8_t open;               ///< Files without any pawns.    +   8 bits
+    uint8_t padding[1];         ///< Fill out the cache line.    +   8 bits
+} pawn_slot_t;                   //                              = 512 bits
 
 /// Pawn table.
 class PawnTable
@@ -157,30 +407,107 @@ class PawnTable
 public:
     PawnTable(int mb = PAWN_TABLE_MB);
     ~PawnTable();
+    void resize(int mb);
+    int get_mb() const;
+    void clear();
+    inline void prefetch(bitboard_t hash) const
+    {
+      /// We're about to probe for this pawn structure.  Start fetching its
+      /// slot into cache now.
+#if defined(__GNUC__)
+      __builtin_prefetch((const void *) &data[hash % slots]);
+#endif
+    }
+    inline bool probe(bitboard_t hash, pawn_slot_t *slot_ptr) const
+    {
+      /// Given the pawn structure described in hash, check the pawn table to
+      /// see if we've evaluated it before.  If so, then copy its previous
+      /// evaluation to the memory pointed to by slot_ptr and return success.
+      /// If not, then return failure.
+      const pawn_slot_t& slot = data[hash % slots];
+      if (slot.hash != hash)
+          return false;
+      *slot_ptr = slot;
+      return true;
+    }
+    inline void store(const pawn_slot_t& slot)
+    {
+      /// We've just evaluated the pawn structure described in slot.hash.  Save
+      /// its evaluation in the pawn table for future probes.
+      data[slot.hash % slots] = slot;
+    }
+private:
+    size_t size;       ///< The slots' size (in bytes).
+    uint64_t slots;    ///< The number of slots.
+    pawn_slot_t *data; ///< The slots themselves.
+
+    void allocate(int mb);
+};
+
+/*----------------------------------------------------------------------------*\
+ |                                 Eval Table                                 |
+\*----------------------------------------------------------------------------*/
+
+/// Eval table slot.
+typedef struct eval_slot
+{
+    bitboard_t hash;     ///< Zobrist hash key.                    64 bits
+    value_t value;       ///< Score (for the color off move).    + 16 bits
+    uint16_t padding[3]; ///< Fill out the slot.                 + 48 bits
+} eval_slot_t;           //                                     = 128 bits
+
+/// Eval table.
+class EvalTable
+{
+public:
+    EvalTable(int mb = EVAL_TABLE_MB);
+    ~EvalTable();
+    void resize(int mb);
+    int get_mb() const;
     void clear();
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+    void reset_counts();
+    inline void prefetch(bitboard_t hash) const
+    {
+      /// We're about to probe for this position.  Start fetching its slot into
+      /// cache now.
+#if defined(__GNUC__)
+      __builtin_prefetch((const void *) &data[hash % slots]);
+#endif
+    }
     inline bool probe(bitboard_t hash, value_t *value_ptr)
     {
-       /// Given the pawn structure described in hash, check the 
-       /// pawn table to see if we've evaluated it before.  If so, 
-       /// then save its previous evaluation to the memory pointed 
-       /// to by value_ptr and return success.  If not, then return
-       /// failure.
-       uint64_t index = hash % slots;
-       bool found = data[index].hash == hash;
-       *value_ptr = found ? data[index].value : 0;
-       return found;
+      /// Given the position described in hash, check the eval table to see if
+      /// we've evaluated it before.  If so, then copy its previous evaluation
+      /// to the memory pointed to by value_ptr and return success.  If not,
+      /// then return failure.
+      const eval_slot_t& slot = data[hash % slots];
+      if (slot.hash != hash)
+      {
+          misses++;
+          return false;
+      }
+      hits++;
+      *value_ptr = slot.value;
+      return true;
     }
     inline void store(bitboard_t hash, value_t value)
     {
-      /// We've just evaluated the pawn structure described in hash.  Save its
-      /// evaluation in the pawn table for future probes.
-      uint64_t index = hash % slots;
-      data[index].hash = hash;
-      data[index].value = value;
+      /// We've just evaluated the position described in hash.  Save its
+      /// evaluation in the eval table for future probes.
+      eval_slot_t& slot = data[hash % slots];
+      slot.hash = hash;
+      slot.value = value;
     }
 private:
+    size_t size;       ///< The slots' size (in bytes).
     uint64_t slots;    ///< The number of slots.
-    pawn_slot_t *data; ///< The slots themselves.
+    eval_slot_t *data; ///< The slots themselves.
+    uint64_t hits;     ///< The number of successful probes.
+    uint64_t misses;   ///< The number of unsuccessful probes.
+
+    void allocate(int mb);
 };
 
 #endif
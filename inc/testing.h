@@ -34,6 +34,9 @@ public:
 
 protected:
 	void test_perft(int depth);
+	void test_table();
+	void test_startup();
+	void test_eval();
 
 private:
 	std::string test_name;
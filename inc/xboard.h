@@ -39,6 +39,10 @@ public:
     void loop(search_base *s, chess_clock *c, book *o);
     void print_output(int ply, int value, int time, int nodes, 
                       MoveArray& pv) const;
+    void print_thread_nodes(int threads, const int *nodes) const;
+    void print_root_moves(MoveArray& moves) const;
+    void print_hashfull(int permille) const;
+    void print_eval_hits(int permille) const;
     void print_result(Move m);
     void print_resignation();
 
@@ -49,6 +53,7 @@ private:
     bool force;               ///< Whether we're in force mode.
     bool draw;                ///< Whether our opponent has offered a draw.
     bool sync;                ///< Whether to sync our clock with XBoard's.
+    int memory_mb;            ///< Hash table size to set once we move, or 0.
 
     board_base *board_ptr;    ///< Board representation object.
     search_base *search_ptr;  ///< Move search engine object.
@@ -90,6 +95,9 @@ private:
     void do_nopost() const;
     void do_analyze();
     void do_exit();
+    void do_cores() const;
+    void do_memory();
+    void do_option();
     void do_display() const;
     void do_test();
     void do_unknown() const;
@@ -153,6 +153,7 @@ const bitboard_t board_base::squares_castle[COLORS][SIDES][REQS] =
 };
 bitboard_t board_base::squares_adj_cols[8];
 bitboard_t board_base::squares_pawn_attacks[COLORS][8][8];
+bitboard_t board_base::squares_unmap[ANGLES][15][256];
 
 bitboard_t board_base::key_piece[COLORS][SHAPES][8][8];
 bitboard_t board_base::key_castle[COLORS][SIDES][CASTLE_STATS];
@@ -164,6 +165,11 @@ bitboard_t board_base::BIT_MSK[8][8];
 bitboard_t board_base::ROW_MSK[8];
 int        board_base::BIT_IDX[8][8];
 
+// Material and piece-square scores and phase weights:
+score_t board_base::value_piece[SHAPES];
+score_t board_base::value_square[COLORS][SHAPES][8][8];
+int     board_base::value_phase[SHAPES];
+
 /*----------------------------------------------------------------------------*\
  |                                board_base()                                |
 \*----------------------------------------------------------------------------*/
@@ -173,21 +179,22 @@ board_base::board_base()
 /// Constructor.  Important!  Seed the random number generator, issue
 /// <code>srand(time(NULL));</code> before instantiating this class!
 
-  //compute single bit masks
-  for (int i=0;i<8;++i)
-  {
-    ROW_MSK[i] = 0xFFULL << i*8;
-    for (int j=0;j<8;++j)
-    {
-      BIT_MSK[j][i] = 1ULL << (i*8+j);
-      BIT_IDX[j][i] = i*8 + j;
-    }
-  }
-
     if (!precomputed_board_base)
     {
+        // Compute the single bit masks (once - other threads' boards may
+        // be reading them).
+        for (int i=0;i<8;++i)
+        {
+          ROW_MSK[i] = 0xFFULL << i*8;
+          for (int j=0;j<8;++j)
+          {
+            BIT_MSK[j][i] = 1ULL << (i*8+j);
+            BIT_IDX[j][i] = i*8 + j;
+          }
+        }
         precomp_king();
         precomp_row();
+        precomp_unmap();
         precomp_knight();
         precomp_pawn();
         precomp_key();
@@ -251,6 +258,7 @@ void board_base::set_board()
     init_state();
     init_rotation();
     init_hash();
+    init_eval();
 }
 
 /*----------------------------------------------------------------------------*\
@@ -394,6 +402,7 @@ bool board_base::set_board_fen(string& fen)
 
     init_rotation();
     init_hash();
+    init_eval();
 
     state.pieceCount = get_num_pieces(WHITE) + get_num_pieces(BLACK);
 
@@ -435,6 +444,7 @@ bool board_base::set_board_fen_error(string& fen, string reason, int x, int y)
     state.pieceCount = 32;
     init_rotation();
     init_hash();
+    init_eval();
 
     return false;
 }
@@ -472,6 +482,20 @@ bool board_base::get_whose() const
     return state.on_move;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                 evaluate()                                 |
+\*----------------------------------------------------------------------------*/
+value_t board_base::evaluate(value_t alpha, value_t beta) const
+{
+
+/// Evaluate the current state, given that all we need to know is how it
+/// compares to the window (alpha, beta) - from the perspective of the color
+/// off move, as with evaluate().  Sub-classes that can save work knowing that
+/// override this; by default, just evaluate.
+
+    return evaluate();
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 get_hash()                                 |
 \*----------------------------------------------------------------------------*/
@@ -483,6 +507,17 @@ bitboard_t board_base::get_hash() const
     return hash;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              get_pawn_hash()                               |
+\*----------------------------------------------------------------------------*/
+bitboard_t board_base::get_pawn_hash() const
+{
+
+/// Return the hash key for the current pawn structure.
+
+    return pawn_hash;
+}
+
 /*----------------------------------------------------------------------------*\
  |                                get_status()                                |
 \*----------------------------------------------------------------------------*/
@@ -560,6 +595,21 @@ unsigned board_base::get_num_pieces(const bool color) const
   return count;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                get_shape()                                 |
+\*----------------------------------------------------------------------------*/
+int board_base::get_shape(int x, int y) const
+{
+
+/// Return the shape of the piece (of the color on move) on the specified
+/// square, or -1 if there's none.
+
+    for (int shape = PAWN; shape <= KING; shape++)
+        if (BIT_GET(state.piece[ON_MOVE][shape], x, y))
+            return shape;
+    return -1;
+}
+
 
 /*----------------------------------------------------------------------------*\
  |                                  check()                                   |
@@ -571,6 +621,49 @@ bool board_base::check(bool off_move) const
     return check(state.piece[defense][KING], offense);
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              get_attack_map()                              |
+\*----------------------------------------------------------------------------*/
+void board_base::get_attack_map(attack_map_t& map) const
+{
+
+/// Work out the squares that each color's pieces attack in the current
+/// position.
+
+    for (int color = WHITE; color <= BLACK; color++)
+    {
+        bitboard_t *shape = map.shape[color];
+        bitboard_t b = state.piece[color][PAWN];
+        if (color == WHITE)
+            shape[PAWN] = (b & ~COL_MSK(0)) << 7 | (b & ~COL_MSK(7)) << 9;
+        else
+            shape[PAWN] = (b & ~COL_MSK(0)) >> 9 | (b & ~COL_MSK(7)) >> 7;
+
+        shape[KNIGHT] = shape[BISHOP] = shape[ROOK] = shape[QUEEN] = 0;
+        for (int s = KNIGHT; s <= QUEEN; s++)
+        {
+            b = state.piece[color][s];
+            for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
+            {
+                x = n & 0x7;
+                y = n >> 3;
+                if (s == KNIGHT)
+                    shape[s] |= squares_knight[x][y];
+                if (s == BISHOP || s == QUEEN)
+                    shape[s] |= attacks_bishop(x, y);
+                if (s == ROOK || s == QUEEN)
+                    shape[s] |= attacks_rook(x, y);
+            }
+        }
+
+        int n = FST(state.piece[color][KING]);
+        shape[KING] = n == -1 ? 0 : squares_king[n & 0x7][n >> 3];
+
+        map.all[color] = shape[PAWN] | shape[KNIGHT] | shape[BISHOP] |
+                         shape[ROOK] | shape[QUEEN] | shape[KING];
+    }
+}
+
 /*----------------------------------------------------------------------------*\
  |                                to_string()                                 |
 \*----------------------------------------------------------------------------*/
@@ -702,6 +795,8 @@ bool board_base::make(Move m)
               }
               hash ^= key_piece[ON_MOVE][shape][m.x1][m.y1];
               hash ^= key_piece[ON_MOVE][shape][m.x2][m.y2];
+              state.position[ON_MOVE] += value_square[ON_MOVE][shape][m.x2][m.y2] -
+                                         value_square[ON_MOVE][shape][m.x1][m.y1];
               if (shape == PAWN)
               {
                   pawn_hash ^= key_piece[ON_MOVE][shape][m.x1][m.y1];
@@ -721,6 +816,9 @@ bool board_base::make(Move m)
               hash ^= key_piece[OFF_MOVE][shape][m.x2][m.y2];
               if (shape == PAWN)
                   pawn_hash ^= key_piece[OFF_MOVE][shape][m.x2][m.y2];
+              state.material[OFF_MOVE] -= value_piece[shape];
+              state.position[OFF_MOVE] -= value_square[OFF_MOVE][shape][m.x2][m.y2];
+              state.phase -= value_phase[shape];
 
               // The move is a capture.  Reset the 50 move rule counter.
               state.fifty = -1;
@@ -762,6 +860,8 @@ bool board_base::make(Move m)
               }
               hash ^= key_piece[ON_MOVE][ROOK][m.x2 == 6 ? 7 : 0][ON_MOVE ? 7 : 0];
               hash ^= key_piece[ON_MOVE][ROOK][m.x2 == 6 ? 5 : 3][ON_MOVE ? 7 : 0];
+              state.position[ON_MOVE] += value_square[ON_MOVE][ROOK][m.x2 == 6 ? 5 : 3][ON_MOVE ? 7 : 0] -
+                                         value_square[ON_MOVE][ROOK][m.x2 == 6 ? 7 : 0][ON_MOVE ? 7 : 0];
               state.castle[ON_MOVE][m.x2 == 6] = HAS_CASTLED;
               hash ^= key_castle[ON_MOVE][m.x2 == 6][HAS_CASTLED];
           }
@@ -789,6 +889,10 @@ bool board_base::make(Move m)
               hash ^= key_piece[ON_MOVE][PAWN][m.x2][m.y2];
               hash ^= key_piece[ON_MOVE][m.promo][m.x2][m.y2];
               pawn_hash ^= key_piece[ON_MOVE][PAWN][m.x2][m.y2];
+              state.material[ON_MOVE] += value_piece[m.promo] - value_piece[PAWN];
+              state.phase += value_phase[m.promo];
+              state.position[ON_MOVE] += value_square[ON_MOVE][m.promo][m.x2][m.y2] -
+                                         value_square[ON_MOVE][PAWN][m.x2][m.y2];
           }
 
           // If we're performing an en passant, then remove the captured pawn.
@@ -799,6 +903,8 @@ bool board_base::make(Move m)
                   BIT_CLR(rotation[angle][OFF_MOVE], coord[MAP][angle][m.x2][m.y1][X], coord[MAP][angle][m.x2][m.y1][Y]);
               hash ^= key_piece[OFF_MOVE][PAWN][m.x2][m.y1];
               pawn_hash ^= key_piece[OFF_MOVE][PAWN][m.x2][m.y1];
+              state.material[OFF_MOVE] -= value_piece[PAWN];
+              state.position[OFF_MOVE] -= value_square[OFF_MOVE][PAWN][m.x2][m.y1];
               state.pieceCount--;
            }
 
@@ -1267,6 +1373,35 @@ void board_base::init_rotation()
         }
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                init_eval()                                 |
+\*----------------------------------------------------------------------------*/
+void board_base::init_eval()
+{
+
+/// Add up each color's material and piece-square scores, and the game phase,
+/// from scratch.  From here on, make() keeps them up to date (and unmake()
+/// restores them along with the rest of the state).
+
+    state.phase = 0;
+    for (int color = WHITE; color <= BLACK; color++)
+    {
+        state.material[color] = state.position[color] = 0;
+        for (int shape = PAWN; shape <= KING; shape++)
+        {
+            bitboard_t b = state.piece[color][shape];
+            for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
+            {
+                x = n & 0x7;
+                y = n >> 3;
+                state.material[color] += value_piece[shape];
+                state.position[color] += value_square[color][shape][x][y];
+                state.phase += value_phase[shape];
+            }
+        }
+    }
+}
+
 /*----------------------------------------------------------------------------*\
  |                                init_hash()                                 |
 \*----------------------------------------------------------------------------*/
@@ -1314,25 +1449,30 @@ void board_base::init_hash()
 void board_base::precomp_key() const
 {
 
-/// Pre-compute the Zobrist hash keys.
+/// Pre-compute the Zobrist hash keys.  Draw them from our own generator,
+/// seeded with KEY_SEED, rather than from rand(): a transposition table saved
+/// to a file is only of use to a later run if that run hashes every position
+/// the same way.
+
+    uint64_t seed = KEY_SEED;
 
     for (int color = WHITE; color <= BLACK; color++)
     {
         for (int shape = PAWN; shape <= KING; shape++)
             for (int y = 0; y <= 7; y++)
                 for (int x = 0; x <= 7; x++)
-                    key_piece[color][shape][x][y] = rand_64();
+                    key_piece[color][shape][x][y] = rand_64(&seed);
 
         for (int side = QUEEN_SIDE; side <= KING_SIDE; side++)
             for (int stat = CAN_CASTLE; stat <= HAS_CASTLED; stat++)
-                key_castle[color][side][stat] = rand_64();
+                key_castle[color][side][stat] = rand_64(&seed);
     }
 
-    key_no_en_passant = rand_64();
+    key_no_en_passant = rand_64(&seed);
     for (int x = 0; x < 8; ++x)
-        key_en_passant[x] = rand_64();
+        key_en_passant[x] = rand_64(&seed);
 
-    key_on_move = rand_64();
+    key_on_move = rand_64(&seed);
 }
 
 /*----------------------------------------------------------------------------*\
@@ -1639,6 +1779,72 @@ void board_base::precomp_king() const
     }
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              precomp_unmap()                               |
+\*----------------------------------------------------------------------------*/
+void board_base::precomp_unmap() const
+{
+
+/// Pre-compute the squares (in a 0 rotated BitBoard) that each row of each
+/// rotated BitBoard stands for, so that a sliding piece's moves can be mapped
+/// back at the cost of a lookup.  (In a 0 rotated BitBoard, a row already is
+/// a row.)
+
+    for (int angle = L45; angle <= R90; angle++)
+        for (int num = 0; num < 15; num++)
+            for (int r = 0; r <= 0xFF; r++)
+            {
+                bitboard_t b = 0;
+                if (angle == ZERO || angle == R90)
+                {
+                    if (num <= 7)
+                        ROW_SET(b, num, r);
+                }
+                else
+                    b = DIAG_SET(num, r & diag_mask[num]);
+                squares_unmap[angle][num][r] = rotate(b, UNMAP, angle);
+            }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               attacks_rook()                               |
+\*----------------------------------------------------------------------------*/
+bitboard_t board_base::attacks_rook(int x, int y) const
+{
+
+/// Return the squares that a rook on (x, y) attacks.
+
+    int num = ROW_NUM(x, y, ZERO);
+    bitrow_t r = squares_row[ROW_LOC(x, y, ZERO)]
+                            [ROW_GET(rotation[ZERO][COLORS], num)];
+    bitboard_t b = 0;
+    ROW_SET(b, num, r);
+
+    num = ROW_NUM(x, y, R90);
+    r = squares_row[ROW_LOC(x, y, R90)][ROW_GET(rotation[R90][COLORS], num)];
+    return b | squares_unmap[R90][num][r];
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              attacks_bishop()                              |
+\*----------------------------------------------------------------------------*/
+bitboard_t board_base::attacks_bishop(int x, int y) const
+{
+
+/// Return the squares that a bishop on (x, y) attacks.
+
+    bitboard_t b = 0;
+    for (int angle = L45; angle == L45 || angle == R45; angle += R45 - L45)
+    {
+        int num = DIAG_NUM(x, y, angle);
+        bitrow_t occ = DIAG_GET(rotation[angle][COLORS], num);
+        b |= squares_unmap[angle][num]
+                          [squares_row[DIAG_LOC(x, y, angle)][occ] &
+                           diag_mask[num]];
+    }
+    return b;
+}
+
 /*----------------------------------------------------------------------------*\
  |                               precomp_row()                                |
 \*----------------------------------------------------------------------------*/
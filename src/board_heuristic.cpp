@@ -117,7 +117,7 @@ const value_t board_heuristic::value_king_position[8][8] =
 
 const value_t board_heuristic::value_king_middle[8][8] = 
 {
-    /* A */ {-60, -40, -20  -10, -10, -20, -40, -60},
+    /* A */ {-60, -40, -20, -10, -10, -20, -40, -60},
     /* B */ {-40, -20, -10,  -5,  -5, -10, -20, -40},
     /* C */ {-20, -10,  -5,   0,   0,  -5, -10, -20},
     /* D */ {-10,  -5,   0,   5,   5,   0,  -5, -10},
@@ -129,11 +129,22 @@ const value_t board_heuristic::value_king_middle[8][8] =
 };
 
 // The values of various pawn structure features:
-const value_t board_heuristic::value_pawn_passed[8]           = {0, 12,  20,  48,  72, 120, 150,   0};
-const value_t board_heuristic::value_pawn_doubled[9]          = {0,  0,  -4,  -7, -10, -10, -10, -10, -10};
-const value_t board_heuristic::value_pawn_isolated[9]         = {0, -8, -20, -40, -60, -70, -80, -80, -80};
-const value_t board_heuristic::value_pawn_doubled_isolated[9] = {0, -5, -10, -15, -15, -15, -15, -15, -15};
-const value_t board_heuristic::value_pawn_duo = 2;
+const score_t board_heuristic::value_pawn_passed[8] =
+    {SCORE(  0,   0), SCORE( 12,  12), SCORE( 20,  20), SCORE( 48,  48),
+     SCORE( 72,  72), SCORE(120, 120), SCORE(150, 150), SCORE(  0,   0)};
+const score_t board_heuristic::value_pawn_doubled[9] =
+    {SCORE(  0,   0), SCORE(  0,   0), SCORE( -4,  -4), SCORE( -7,  -7),
+     SCORE(-10, -10), SCORE(-10, -10), SCORE(-10, -10), SCORE(-10, -10),
+     SCORE(-10, -10)};
+const score_t board_heuristic::value_pawn_isolated[9] =
+    {SCORE(  0,   0), SCORE( -8,  -8), SCORE(-20, -20), SCORE(-40, -40),
+     SCORE(-60, -60), SCORE(-70, -70), SCORE(-80, -80), SCORE(-80, -80),
+     SCORE(-80, -80)};
+const score_t board_heuristic::value_pawn_doubled_isolated[9] =
+    {SCORE(  0,   0), SCORE( -5,  -5), SCORE(-10, -10), SCORE(-15, -15),
+     SCORE(-15, -15), SCORE(-15, -15), SCORE(-15, -15), SCORE(-15, -15),
+     SCORE(-15, -15)};
+const score_t board_heuristic::value_pawn_duo = SCORE(2, 2);
 
 //
 const value_t board_heuristic::value_knight_outpost[8][8] =
@@ -150,24 +161,44 @@ const value_t board_heuristic::value_knight_outpost[8][8] =
 };
 
 //
-const value_t board_heuristic::value_bishop_over_knight = 36;
-const value_t board_heuristic::value_bishop_trapped = -174;
+const score_t board_heuristic::value_bishop_over_knight = SCORE(0, 36);
+const score_t board_heuristic::value_bishop_trapped = SCORE(-174, -174);
 
 //
-const value_t board_heuristic::value_rook_on_7th = 24;
-const value_t board_heuristic::value_rooks_on_7th = 10;
+const score_t board_heuristic::value_rook_on_7th = SCORE(24, 24);
+const score_t board_heuristic::value_rooks_on_7th = SCORE(10, 10);
+const score_t board_heuristic::value_rook_open_file = SCORE(20, 10);
+const score_t board_heuristic::value_rook_half_open_file = SCORE(10, 5);
 
 //
-const value_t board_heuristic::value_queen_rook_on_7th = 50;
-const value_t board_heuristic::value_queen_offside = -30;
+const score_t board_heuristic::value_queen_rook_on_7th = SCORE(50, 50);
+const score_t board_heuristic::value_queen_offside = SCORE(-30, -30);
 
 // The penalty for giving up castling:
-const value_t board_heuristic::value_king_cant_castle = -20;
+const score_t board_heuristic::value_king_cant_castle = SCORE(-20, 0);
+
+//
+const score_t board_heuristic::value_mobility[SHAPES] =
+    {SCORE(0, 0), SCORE(4, 4), SCORE(5, 5), SCORE(2, 4), SCORE(1, 2),
+     SCORE(0, 0)};
+const int board_heuristic::value_king_attacker[SHAPES] = {0, 2, 2, 3, 5, 0};
+const score_t board_heuristic::value_king_attacked[16] =
+    {SCORE(   0,   0), SCORE(   0,   0), SCORE(  -4,  -1), SCORE(  -8,  -2),
+     SCORE( -14,  -3), SCORE( -22,  -5), SCORE( -32,  -8), SCORE( -44, -11),
+     SCORE( -58, -14), SCORE( -74, -18), SCORE( -92, -23), SCORE(-112, -28),
+     SCORE(-134, -33), SCORE(-158, -39), SCORE(-184, -46), SCORE(-212, -53)};
+const score_t board_heuristic::value_hanging = SCORE(-30, -30);
 
 bool board_heuristic::precomputed_board_heuristic = false;
 bitboard_t board_heuristic::squares_pawn_duo[8][8];
 bitboard_t board_heuristic::squares_pawn_potential_attacks[COLORS][8][8];
-PawnTable board_heuristic::pawn_table;
+int board_heuristic::pawn_table_mb = PAWN_TABLE_MB;
+int board_heuristic::pawn_table_mb_wanted = PAWN_TABLE_MB;
+int board_heuristic::eval_table_mb = EVAL_TABLE_MB;
+int board_heuristic::eval_table_mb_wanted = EVAL_TABLE_MB;
+score_t board_heuristic::value_lazy[COLORS][SHAPES][8][8];
+bool board_heuristic::lazy_eval = false;
+bool board_heuristic::attack_eval = false;
 
 /*----------------------------------------------------------------------------*\
  |                             board_heuristic()                              |
@@ -180,8 +211,15 @@ board_heuristic::board_heuristic() : board_base()
     if (!precomputed_board_heuristic)
     {
         precomp_pawn();
+        precomp_value();
+        precomp_lazy();
         precomputed_board_heuristic = true;
+
+        // Our board was set up before there were any values to add up.
+        init_eval();
     }
+    pawn_table = NULL;
+    eval_table = NULL;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -192,6 +230,8 @@ board_heuristic::~board_heuristic()
 
 /// Destructor.
 
+    delete pawn_table;
+    delete eval_table;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -200,13 +240,156 @@ board_heuristic::~board_heuristic()
 board_heuristic& board_heuristic::operator=(const board_heuristic& that)
 {
 
-/// Overloaded assignment operator.
+/// Overloaded assignment operator.  (We keep our own pawn and eval tables.)
 
     if (this != &that)
         board_base::operator=(that);
     return *this;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                   make()                                   |
+\*----------------------------------------------------------------------------*/
+bool board_heuristic::make(Move m)
+{
+
+/// Make a move, and return whether it's a capture.  We'll probably evaluate
+/// the new position soon - so start fetching its eval table slot into cache
+/// now, and if the move changes the pawn structure, its pawn table slot too.
+
+    bitboard_t old_pawn_hash = pawn_hash;
+    bool capture = board_base::make(m);
+    if (eval_table)
+        eval_table->prefetch(hash);
+    if (pawn_hash != old_pawn_hash && pawn_table)
+        pawn_table->prefetch(pawn_hash);
+    return capture;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            set_pawn_table_mb()                             |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::set_pawn_table_mb(int mb)
+{
+
+/// Set the size of each board's pawn table.  Each board resizes its own table
+/// the next time that it's evaluated, so this is safe even while other threads
+/// are evaluating.  (If memory is tight, fit_tables() may make do with less.)
+
+    pawn_table_mb = pawn_table_mb_wanted = mb;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            get_pawn_table_mb()                             |
+\*----------------------------------------------------------------------------*/
+int board_heuristic::get_pawn_table_mb()
+{
+
+/// Return the size that we've been asked for each board's pawn table (in MB).
+
+    return pawn_table_mb_wanted;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            set_eval_table_mb()                             |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::set_eval_table_mb(int mb)
+{
+
+/// Set the size of each board's eval table.  As with the pawn tables, each
+/// board resizes its own the next time that it's evaluated.
+
+    eval_table_mb = eval_table_mb_wanted = mb;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            get_eval_table_mb()                             |
+\*----------------------------------------------------------------------------*/
+int board_heuristic::get_eval_table_mb()
+{
+
+/// Return the size that we've been asked for each board's eval table (in MB).
+
+    return eval_table_mb_wanted;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                fit_tables()                                |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::fit_tables(int pawn_mb, int eval_mb)
+{
+
+/// Make each board's pawn and eval tables no bigger than the specified sizes
+/// (in MB), to fit in a memory budget - but no bigger than we've been asked
+/// for, either.  The sizes asked for stay put, so that a bigger budget later
+/// on can bring them back.
+
+    pawn_table_mb = LESSER(pawn_mb, pawn_table_mb_wanted);
+    eval_table_mb = LESSER(eval_mb, eval_table_mb_wanted);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              get_eval_hits()                               |
+\*----------------------------------------------------------------------------*/
+uint64_t board_heuristic::get_eval_hits() const
+{
+
+/// Return how many of this board's evaluations came from its eval table.
+
+    return eval_table ? eval_table->get_hits() : 0;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             get_eval_misses()                              |
+\*----------------------------------------------------------------------------*/
+uint64_t board_heuristic::get_eval_misses() const
+{
+
+/// Return how many of this board's evaluations had to be worked out.
+
+    return eval_table ? eval_table->get_misses() : 0;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            reset_eval_counts()                             |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::reset_eval_counts()
+{
+
+/// Start counting this board's eval table hits and misses afresh.
+
+    if (eval_table)
+        eval_table->reset_counts();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              set_lazy_eval()                               |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::set_lazy_eval(bool lazy)
+{
+
+/// Set whether evaluate(alpha, beta) may stop short once the score is bound to
+/// fall outside the window.
+
+    lazy_eval = lazy;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             set_attack_eval()                              |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::set_attack_eval(bool attacks)
+{
+
+/// Set whether to evaluate what the pieces attack (see evaluate_attacks()).
+/// Building the attack map costs most of an evaluation again, so it's off
+/// unless asked for.  The lazy evaluation bounds depend on it, so work them
+/// out again.
+
+    attack_eval = attacks;
+    if (precomputed_board_heuristic)
+        precomp_lazy();
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 evaluate()                                 |
 \*----------------------------------------------------------------------------*/
@@ -216,59 +399,166 @@ value_t board_heuristic::evaluate() const
 /// Evaluate the current state.  For simplicity's sake, evaluate from the
 /// perspective of the player who's just moved (the color that's off move).
 
-    value_t sum = 0;
+    return evaluate(-VALUE_ILLEGAL, VALUE_ILLEGAL);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                 evaluate()                                 |
+\*----------------------------------------------------------------------------*/
+value_t board_heuristic::evaluate(value_t alpha, value_t beta) const
+{
+
+/// Evaluate the current state, from the perspective of the color off move.
+/// If we've evaluated it before, then take our previous evaluation from the
+/// eval table.  If not, then work it out (see evaluate_terms()), and save it
+/// for next time - unless it's only a lazy bound.
+
+    value_t value;
+    bool exact;
+
+    // Get our eval table ready, in the size that was asked for.
+    if (!eval_table)
+        eval_table = new EvalTable(eval_table_mb);
+    else if (eval_table->get_mb() != eval_table_mb)
+        eval_table->resize(eval_table_mb);
+
+    // If we've already evaluated this position, return our previous
+    // evaluation.  (The hash key covers whose move it is, so the perspective
+    // matches.)
+    if (eval_table->probe(hash, &value))
+        return value;
+
+    value = evaluate_terms(alpha, beta, &exact);
+    if (exact)
+        eval_table->store(hash, value);
+    return value;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            evaluate_uncached()                             |
+\*----------------------------------------------------------------------------*/
+value_t board_heuristic::evaluate_uncached() const
+{
+
+/// Evaluate the current state in full, as evaluate() does, but without looking
+/// in (or adding to) the eval table.  Only the evaluator benchmark wants this.
+
+    bool exact;
+    return evaluate_terms(-VALUE_ILLEGAL, VALUE_ILLEGAL, &exact);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              evaluate_terms()                              |
+\*----------------------------------------------------------------------------*/
+value_t board_heuristic::evaluate_terms(value_t alpha, value_t beta,
+                                        bool *exact) const
+{
+
+/// Work out the evaluation of the current state, from the perspective of the
+/// color off move.  Add up the middlegame and endgame scores, then blend them
+/// according to how much material is left on the board.
+///
+/// If lazy evaluation is on, then add up the cheap terms (material, position,
+/// and pawn structure) first.  If the rest of the terms can't possibly bring
+/// that score back into the window (alpha, beta), then don't bother with them:
+/// just return the bound that they can't get past, and clear exact.
+
+    score_t sum = 0;
+    pawn_slot_t pawns;
+    value_t value;
+    int phase = LESSER(state.phase, PHASE_MAX);
+
+    *exact = false;
 
     //if (!state.piece[ON_MOVE][KING])
         //return VALUE_ILLEGAL;
 
-    sum += evaluate_pawns();
-    sum += evaluate_knights();
-    sum += evaluate_bishops();
-    sum += evaluate_rooks();
+    // Material and position are kept up to date as moves are made.
+    sum += state.material[OFF_MOVE] + state.position[OFF_MOVE];
+    sum -= state.material[ON_MOVE] + state.position[ON_MOVE];
+
+    sum += evaluate_pawns(pawns);
+
+    if (lazy_eval)
+    {
+        score_t rest = 0;
+        for (int color = WHITE; color <= BLACK; color++)
+            for (int shape = KNIGHT; shape <= KING; shape++)
+            {
+                bitboard_t b = state.piece[color][shape];
+                for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
+                {
+                    x = n & 0x7;
+                    y = n >> 3;
+                    rest += value_lazy[color][shape][x][y];
+                }
+            }
+        value = (SCORE_MG(sum) * phase + SCORE_EG(sum) * (PHASE_MAX - phase)) /
+                PHASE_MAX;
+        // (Add one for the rounding in the blend.)
+        int margin = (SCORE_MG(rest) * phase +
+                      SCORE_EG(rest) * (PHASE_MAX - phase)) / PHASE_MAX + 1;
+        if (value + margin <= alpha)
+            return value + margin;
+        if (value - margin >= beta)
+            return value - margin;
+    }
+
+    sum += evaluate_knights(pawns);
+    sum += evaluate_bishops(pawns);
+    sum += evaluate_rooks(pawns);
     sum += evaluate_queens();
-    sum += evaluate_kings();
-    return sum;
+    sum += evaluate_kings(pawns);
+    if (attack_eval)
+        sum += evaluate_attacks();
+
+    *exact = true;
+    return (SCORE_MG(sum) * phase + SCORE_EG(sum) * (PHASE_MAX - phase)) /
+           PHASE_MAX;
 }
 
 /*----------------------------------------------------------------------------*\
  |                              evaluate_pawns()                              |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_pawns() const
+score_t board_heuristic::evaluate_pawns(pawn_slot_t& pawns) const
 {
 
-/// Evaluate pawn structure.
+/// Evaluate pawn structure, and fill in pawns with what the other pieces'
+/// evaluations need to know about it.
+
+    value_t sign;
+    score_t sum = 0;
 
-    value_t sign, sum = 0;
+    // Get our pawn table ready, in the size that was asked for.
+    if (!pawn_table)
+        pawn_table = new PawnTable(pawn_table_mb);
+    else if (pawn_table->get_mb() != pawn_table_mb)
+        pawn_table->resize(pawn_table_mb);
 
     // If we've already evaluated this pawn structure, return our previous
     // evaluation.
-    if (!pawn_table.probe(pawn_hash, &sum))
+    if (!pawn_table->probe(pawn_hash, &pawns))
     {
+      pawns.hash = pawn_hash;
       for (int color = WHITE; color <= BLACK; color++)
       {
         sign = !color ? 1 : -1;
         bitboard_t b = state.piece[color][PAWN];
         int num_isolated = 0;
+        pawns.passed[color] = 0;
+        pawns.half_open[color] = 0xFF;
         for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
         {
             x = n & 0x7;
             y = n >> 3;
 
-            // Reward material.
-            sum += sign * value_material[PAWN];
-
-            // Penalize bad position or reward good position.
-            if (color == WHITE)
-              sum += sign * value_position[PAWN][x][y];
-            else
-              sum += sign * value_position[PAWN][7-x][7-y];
-
             //
-            bitboard_t pawns = state.piece[color][PAWN];
-            bitboard_t pawns_on_col = pawns & COL_MSK(y);
+            bitboard_t friends = state.piece[color][PAWN];
+            bitboard_t pawns_on_col = friends & COL_MSK(x);
             int num_on_col = count_64(pawns_on_col);
+            pawns.half_open[color] &= ~(1 << x);
 
-            if (!(pawns & squares_adj_cols[x]))
+            if (!(friends & squares_adj_cols[x]))
             {
                 // Count isolated pawns and penalize isolated doubled pawns.
                 num_isolated++;
@@ -282,23 +572,56 @@ value_t board_heuristic::evaluate_pawns() const
                 sum += sign * value_pawn_doubled[num_on_col];
 
                 // Reward pawn duos.
-                if (pawns & squares_pawn_duo[x][y])
+                if (friends & squares_pawn_duo[x][y])
                     sum += sign * value_pawn_duo;
             }
 
-            // Reward passed pawns.
-            if (!(state.piece[!color][PAWN] & squares_pawn_potential_attacks[!color][x][y]))
+            // Reward passed pawns: those that no enemy pawn stands in front
+            // of, or can ever capture.
+            bitboard_t ahead = !color ? ~0ULL << 8 * (y + 1) : (1ULL << 8 * y) - 1;
+            if (!(state.piece[!color][PAWN] &
+                  (squares_pawn_potential_attacks[!color][x][y] |
+                   (COL_MSK(x) & ahead))))
+            {
+                BIT_SET(pawns.passed[color], x, y);
                 sum += sign * value_pawn_passed[!color ? y : 7 - y];
+            }
 
             // TODO: Reward hidden passed pawns.
         }
 
         // Penalize isolated pawns.
         sum += sign * value_pawn_isolated[num_isolated];
+
+        // Note the squares that this color's pawns attack, and the holes -
+        // the squares that they never can, however far they advance.
+        b = state.piece[color][PAWN];
+        bitboard_t span;
+        if (color == WHITE)
+        {
+            span = pawns.attacks[color] = (b & ~COL_MSK(0)) << 7 |
+                                          (b & ~COL_MSK(7)) << 9;
+            span |= span << 8;
+            span |= span << 16;
+            span |= span << 32;
+        }
+        else
+        {
+            span = pawns.attacks[color] = (b & ~COL_MSK(7)) >> 7 |
+                                          (b & ~COL_MSK(0)) >> 9;
+            span |= span >> 8;
+            span |= span >> 16;
+            span |= span >> 32;
+        }
+        pawns.holes[color] = ~span;
       } //end color
 
-      pawn_table.store(pawn_hash, sum);
+      pawns.open = pawns.half_open[WHITE] & pawns.half_open[BLACK];
+      pawns.value = sum;
+      pawn_table->store(pawns);
     } //end table probe
+    else
+      sum = pawns.value;
 
     sign = !OFF_MOVE ? 1 : -1;
     return sign * sum;
@@ -307,41 +630,32 @@ value_t board_heuristic::evaluate_pawns() const
 /*----------------------------------------------------------------------------*\
  |                             evaluate_knights()                             |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_knights() const
+score_t board_heuristic::evaluate_knights(const pawn_slot_t& pawns) const
 {
-    value_t sign, sum = 0;
+    value_t sign;
+    score_t sum = 0;
     bitboard_t b;
 
     for (int color = WHITE; color <= BLACK; color++)
     {
         sign = color == OFF_MOVE ? 1 : -1;
-        b = state.piece[color][KNIGHT];
+
+        // Reward outposts: holes in the enemy's pawn structure, defended by
+        // our own pawns.  (Only look at the knights that are on one.)
+        b = state.piece[color][KNIGHT] & pawns.holes[!color] &
+            pawns.attacks[color];
         for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
         {
             x = n & 0x7;
             y = n >> 3;
-
-            // Reward material.
-            sum += sign * value_material[KNIGHT];
-
-            // Penalize bad position or reward good position.
-            sum += sign * value_position[KNIGHT][x][y];
-
-            // Reward outposts.
-            if (squares_pawn_potential_attacks[!color][x][y] &
-                state.piece[!color][PAWN])
-            {
-                if (squares_pawn_attacks[color][x][y] &
-                    state.piece[color][PAWN])
-                {
-                  if (color == WHITE)
-                    sum += sign * value_knight_outpost[x][y];
-                  else
-                    sum += sign * value_knight_outpost[7-x][7-y];
-                }
-            }
-            // TODO: Reward blocking center pawns.
+            if (color == WHITE)
+              sum += sign * SCORE(value_knight_outpost[x][y],
+                                  value_knight_outpost[x][y]);
+            else
+              sum += sign * SCORE(value_knight_outpost[7-x][7-y],
+                                  value_knight_outpost[7-x][7-y]);
         }
+        // TODO: Reward blocking center pawns.
     }
     return sum;
 }
@@ -349,47 +663,41 @@ value_t board_heuristic::evaluate_knights() const
 /*----------------------------------------------------------------------------*\
  |                             evaluate_bishops()                             |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_bishops() const
+score_t board_heuristic::evaluate_bishops(const pawn_slot_t& pawns) const
 {
-    value_t sign, sum = 0;
-    bitboard_t b, squares_both_sides, all_pawns;
+    value_t sign;
+    score_t sum = 0;
+    bitboard_t b;
     bool enemy_bishop_present;
 
     for (int color = WHITE; color <= BLACK; color++)
     {
         sign = color == OFF_MOVE ? 1 : -1;
-        b = state.piece[color][BISHOP];
-        for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
-        {
-            x = n & 0x7;
-            y = n >> 3;
-
-            // Reward material.
-            sum += sign * value_material[BISHOP];
 
-            // Penalize bad position or reward good position.
-            sum += sign * value_position[BISHOP][x][y];
+        // TODO: Reward blocking center pawns.
 
-            // TODO: Reward blocking center pawns.
+        // Reward bishops (over knights) during endgames with pawns on both
+        // sides of the board.
+        //int friendly_piece_count = count_64(ALL(state, color));
 
-            // Reward bishops (over knights) during endgames with pawns on both
-            // sides of the board.
-            //int friendly_piece_count = count_64(ALL(state, color));
+        enemy_bishop_present = (state.piece[!color][BISHOP]?true:false);
+        if (!enemy_bishop_present)
+        {
+          // Files A-C and F-H.
+          if (~pawns.open & 0xE7)
+          {
+            sum += sign * count_64(state.piece[color][BISHOP]) *
+                value_bishop_over_knight;
+          }
+        }
 
-            if (state.pieceCount < 7)
-            {
-              enemy_bishop_present = (state.piece[!color][BISHOP]?true:false);
-              if (!enemy_bishop_present)
-              {
-                all_pawns = state.piece[WHITE][PAWN] | state.piece[BLACK][PAWN];
-                squares_both_sides = COL_MSK(0) | COL_MSK(1) | COL_MSK(2) |
-                                     COL_MSK(5) | COL_MSK(6) | COL_MSK(7);
-                if (all_pawns & squares_both_sides)
-                {
-                  sum += sign * value_bishop_over_knight;
-                }
-              }
-            }
+        // Only a bishop on our opponent's first two ranks can be trapped.
+        b = state.piece[color][BISHOP] &
+            (color == WHITE ? ROW_MSK[6] | ROW_MSK[7] : ROW_MSK[0] | ROW_MSK[1]);
+        for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
+        {
+            x = n & 0x7;
+            y = n >> 3;
 
             // Penalize trapped or potentially trapped bishops.
             if (color == WHITE)
@@ -420,49 +728,51 @@ value_t board_heuristic::evaluate_bishops() const
 /*----------------------------------------------------------------------------*\
  |                              evaluate_rooks()                              |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_rooks() const
+score_t board_heuristic::evaluate_rooks(const pawn_slot_t& pawns) const
 {
-    value_t sign, sum = 0;
+    value_t sign;
+    score_t sum = 0;
     bitboard_t b, rooks_on_7th, rooks, enemy_pawns, seventh_row, enemy_king,
         eighth_row;
     int num_rooks_on_7th, eighth;
     bool is_enemy_pawn_on_7th, is_enemy_king_on_8th;
 
+    // Spread the open files out over every rank.
+    bitboard_t open = (bitboard_t) pawns.open * 0x0101010101010101ULL;
+
     for (int color = WHITE; color <= BLACK; color++)
     {
         sign = color == OFF_MOVE ? 1 : -1;
-        b = state.piece[color][ROOK];
+
+        // Reward rooks on open and half-open files.
+        rooks = state.piece[color][ROOK];
+        sum += sign * count_64(rooks & open) * value_rook_open_file;
+        sum += sign * count_64(rooks & ~open &
+            (bitboard_t) pawns.half_open[color] * 0x0101010101010101ULL) *
+            value_rook_half_open_file;
+
+        //
+        int seventh = color == WHITE ? 6 : 1;
+        b = state.piece[color][ROOK] & ROW_MSK[seventh];
         for (int n, x, y; (n = FST(b)) != -1; BIT_CLR(b, x, y))
         {
             x = n & 0x7;
             y = n >> 3;
-
-            // Reward material.
-            sum += sign * value_material[ROOK];
-
-            // Penalize bad position or reward good position.
-            sum += sign * value_position[ROOK][x][y];
-
-            //
-            int seventh = color == WHITE ? 6 : 1;
-            if (y == seventh)
+            enemy_pawns = state.piece[!color][PAWN];
+            seventh_row = ROW_MSK[seventh];
+            is_enemy_pawn_on_7th = (enemy_pawns & seventh_row)?true:false;
+            enemy_king = state.piece[!color][KING];
+            eighth = color == WHITE ? 7 : 0;
+            eighth_row = ROW_MSK[eighth];
+            is_enemy_king_on_8th = (enemy_king & eighth_row)?true:false;
+            if (is_enemy_pawn_on_7th || is_enemy_king_on_8th)
             {
-              enemy_pawns = state.piece[!color][PAWN];
-              seventh_row = ROW_MSK[seventh];
-              is_enemy_pawn_on_7th = (enemy_pawns & seventh_row)?true:false;
-              enemy_king = state.piece[!color][KING];
-              eighth = color == WHITE ? 7 : 0;
-              eighth_row = ROW_MSK[eighth];
-              is_enemy_king_on_8th = (enemy_king & eighth_row)?true:false;
-              if (is_enemy_pawn_on_7th || is_enemy_king_on_8th)
-              {
-                sum += sign * value_rook_on_7th;
-                rooks = state.piece[color][ROOK];
-                rooks_on_7th = rooks & seventh_row;
-                num_rooks_on_7th = count_64(rooks_on_7th);
-                if (num_rooks_on_7th >= 2)
-                  sum += sign * value_rooks_on_7th;
-              }
+              sum += sign * value_rook_on_7th;
+              rooks = state.piece[color][ROOK];
+              rooks_on_7th = rooks & seventh_row;
+              num_rooks_on_7th = count_64(rooks_on_7th);
+              if (num_rooks_on_7th >= 2)
+                sum += sign * value_rooks_on_7th;
             }
         }
     }
@@ -472,9 +782,10 @@ value_t board_heuristic::evaluate_rooks() const
 /*----------------------------------------------------------------------------*\
  |                             evaluate_queens()                              |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_queens() const
+score_t board_heuristic::evaluate_queens() const
 {
-    value_t sign, sum = 0;
+    value_t sign;
+    score_t sum = 0;
     bitboard_t b, rooks, enemy_pawns, seventh_row, enemy_king, eighth_row;
     int seventh, eighth;
     bool is_queen_on_7th, is_enemy_pawn_on_7th,
@@ -489,12 +800,6 @@ value_t board_heuristic::evaluate_queens() const
             x = n & 0x7;
             y = n >> 3;
 
-            // Reward material.
-            sum += sign * value_material[QUEEN];
-
-            // Penalize bad position or reward good position.
-            sum += sign * value_position[QUEEN][x][y];
-
             //
             seventh = color == WHITE ? 6 : 1;
             is_queen_on_7th = y == seventh;
@@ -530,9 +835,10 @@ value_t board_heuristic::evaluate_queens() const
 /*----------------------------------------------------------------------------*\
  |                              evaluate_kings()                              |
 \*----------------------------------------------------------------------------*/
-value_t board_heuristic::evaluate_kings() const
+score_t board_heuristic::evaluate_kings(const pawn_slot_t& pawns) const
 {
-    value_t sign, sum = 0;
+    value_t sign;
+    score_t sum = 0;
 
     for (int color = WHITE; color <= BLACK; color++)
     {
@@ -547,8 +853,8 @@ value_t board_heuristic::evaluate_kings() const
             sum += sign * value_king_cant_castle;
 
         // Penalize bad position or reward good position.
-        bitboard_t pawns = state.piece[WHITE][PAWN] | state.piece[BLACK][PAWN];
-        if (pawns & SQUARES_QUEEN_SIDE && pawns & SQUARES_KING_SIDE)
+        int files = ~pawns.open & 0xFF;
+        if (files & 0x0F && files & 0xF0)
         {
             // There are pawns on both sides of the board.  The king should be
             // in the middle.
@@ -562,36 +868,220 @@ value_t board_heuristic::evaluate_kings() const
             //middle of the board, even in the middle of a heated battle
 
         }
-        else if (pawns)
+        else if (files)
         {
             // There are pawns on only one side of the board.  The king should
             // be on that side.
-            if (pawns & SQUARES_QUEEN_SIDE)
+            if (files & 0x0F)
             {
-              sum += sign * value_king_position[x][!color?y:7-y];
+              sum += sign * SCORE(0, value_king_position[x][!color?y:7-y]);
             }
             else
             {
-              sum += sign * value_king_position[7-x][!color?y:7-y];
+              sum += sign * SCORE(0, value_king_position[7-x][!color?y:7-y]);
             }
         }
 
-        if (state.pieceCount < 7)
+        //middle of the board is better for end game
+        sum += sign * SCORE(0, value_king_middle[x][y]);
+
+        //but it is more important to push the other king
+        //to the edge if we can
+        int n2 = FST(state.piece[!color][KING]);
+        int x2 = n2 & 0x7;
+        int y2 = n2 >> 3;
+        sum += -2 * sign * SCORE(0, value_king_middle[x2][y2]);
+    }
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             evaluate_attacks()                             |
+\*----------------------------------------------------------------------------*/
+score_t board_heuristic::evaluate_attacks() const
+{
+
+/// Evaluate what the pieces attack: mobility, attacks on the squares around
+/// the kings, and pieces left en prise.  All of these read the position's
+/// attack map, which we build once here.
+
+    value_t sign;
+    score_t sum = 0;
+    attack_map_t attacks;
+    get_attack_map(attacks);
+
+    for (int color = WHITE; color <= BLACK; color++)
+    {
+        sign = color == OFF_MOVE ? 1 : -1;
+        const bitboard_t *ours = attacks.shape[color];
+        const bitboard_t *theirs = attacks.shape[!color];
+
+        // Reward mobility: squares that our pieces attack that aren't taken by
+        // our own pieces or covered by the enemy's pawns.
+        bitboard_t area = ~ALL(state, color) & ~theirs[PAWN];
+        for (int shape = KNIGHT; shape <= QUEEN; shape++)
+            sum += sign * count_64(ours[shape] & area) * value_mobility[shape];
+
+        // Penalize the enemy's attacks on the squares around our king.
+        int n = FST(state.piece[color][KING]);
+        if (n != -1)
+        {
+            bitboard_t zone = squares_king[n & 0x7][n >> 3] |
+                              state.piece[color][KING];
+            int units = 0;
+            for (int shape = KNIGHT; shape <= QUEEN; shape++)
+                units += count_64(theirs[shape] & zone) *
+                         value_king_attacker[shape];
+            sum += sign * value_king_attacked[LESSER(units, 15)];
+        }
+
+        // Penalize pieces en prise: attacked by the enemy's pawns, or attacked
+        // and not defended.  This only counts against the color that's just
+        // moved - the color on move can still move its pieces out of the way.
+        if (color == OFF_MOVE)
         {
-            //middle of the board is better for end game
-            sum += sign * value_king_middle[x][y];            
-
-            //but it is more important to push the other king
-            //to the edge if we can
-            int n = FST(state.piece[!color][KING]);
-            int x2 = n & 0x7;
-            int y2 = n >> 3;
-            sum += -2 * sign * value_king_middle[x2][y2];
+            bitboard_t pieces = state.piece[color][KNIGHT] |
+                                state.piece[color][BISHOP] |
+                                state.piece[color][ROOK] |
+                                state.piece[color][QUEEN];
+            bitboard_t hanging = pieces &
+                (theirs[PAWN] | (attacks.all[!color] & ~attacks.all[color]));
+            sum += count_64(hanging) * value_hanging;
         }
     }
     return sum;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              precomp_value()                               |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::precomp_value() const
+{
+
+/// Hand our material and piece-square values down to board_base, which keeps
+/// them added up as moves are made.  The pawn table is from white's point of
+/// view; the others are symmetrical.  The kings are always on the board, so
+/// their material cancels out - and they have no piece-square values (their
+/// position depends on the pawns, so evaluate_kings() sees to it).  And hand
+/// down how much each piece counts towards the game phase.
+
+    for (int shape = PAWN; shape <= KING; shape++)
+    {
+        int material = shape == KING ? 0 : value_material[shape];
+        value_phase[shape] = shape == KNIGHT ? PHASE_KNIGHT :
+                             shape == BISHOP ? PHASE_BISHOP :
+                             shape == ROOK   ? PHASE_ROOK   :
+                             shape == QUEEN  ? PHASE_QUEEN  : 0;
+        value_piece[shape] = SCORE(material, material);
+        for (int x = 0; x <= 7; x++)
+            for (int y = 0; y <= 7; y++)
+            {
+                int value = shape == KING ? 0 : value_position[shape][x][y];
+                value_square[WHITE][shape][x][y] = SCORE(value, value);
+                value_square[BLACK][shape][shape == PAWN ? 7 - x : x]
+                                          [shape == PAWN ? 7 - y : y] =
+                    SCORE(value, value);
+            }
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               precomp_lazy()                               |
+\*----------------------------------------------------------------------------*/
+void board_heuristic::precomp_lazy()
+{
+
+/// Work out the most that evaluate_knights() ... evaluate_kings() (and
+/// evaluate_attacks(), if it's on) can add to (or take away from) the score for
+/// a piece of each color and shape on each square, in the middlegame and in the
+/// endgame, from the values that they add up.  (The pawn structure is always
+/// evaluated, so pawns get no bound.)
+
+    int king_position = 0, king_middle = 0;
+    const int mobility[SHAPES] = {0, 8, 13, 14, 27, 0}; // Most squares attacked.
+    for (int x = 0; x <= 7; x++)
+        for (int y = 0; y <= 7; y++)
+        {
+            king_position =
+                GREATER(king_position, ABS(value_king_position[x][y]));
+            king_middle = GREATER(king_middle, ABS(value_king_middle[x][y]));
+        }
+
+    for (int color = WHITE; color <= BLACK; color++)
+    {
+        int seventh = color == WHITE ? 6 : 1;
+        int eighth = color == WHITE ? 7 : 0;
+        for (int x = 0; x <= 7; x++)
+            for (int y = 0; y <= 7; y++)
+            {
+                value_lazy[color][PAWN][x][y] = 0;
+
+                // A knight on an outpost.
+                int outpost = color == WHITE ? value_knight_outpost[x][y] :
+                                               value_knight_outpost[7-x][7-y];
+                value_lazy[color][KNIGHT][x][y] = SCORE(outpost, outpost);
+
+                // A bishop that's better than a knight, but perhaps trapped.
+                value_lazy[color][BISHOP][x][y] =
+                    magnitude(value_bishop_over_knight);
+                if (((x == 0 || x == 7) && y == seventh) ||
+                    ((x == 1 || x == 6) && y == eighth))
+                    value_lazy[color][BISHOP][x][y] +=
+                        magnitude(value_bishop_trapped);
+
+                // A rook on an open file, perhaps on the 7th with another.
+                value_lazy[color][ROOK][x][y] = SCORE(
+                    GREATER(SCORE_MG(magnitude(value_rook_open_file)),
+                            SCORE_MG(magnitude(value_rook_half_open_file))),
+                    GREATER(SCORE_EG(magnitude(value_rook_open_file)),
+                            SCORE_EG(magnitude(value_rook_half_open_file))));
+                if (y == seventh)
+                    value_lazy[color][ROOK][x][y] +=
+                        magnitude(value_rook_on_7th) +
+                        magnitude(value_rooks_on_7th);
+
+                // A queen on the 7th with a rook, or offside.
+                value_lazy[color][QUEEN][x][y] = 0;
+                if (y == seventh)
+                    value_lazy[color][QUEEN][x][y] +=
+                        magnitude(value_queen_rook_on_7th);
+                if (x <= 1 || x >= 6)
+                    value_lazy[color][QUEEN][x][y] +=
+                        magnitude(value_queen_offside);
+
+                // A king that can't castle, on the wrong side of the pawns,
+                // in the corner, with the enemy king in the middle (which
+                // counts double).
+                value_lazy[color][KING][x][y] =
+                    magnitude(value_king_cant_castle) +
+                    SCORE(0, king_position + 3 * king_middle);
+
+                // Then the attacks (if we evaluate them): a piece that's as
+                // mobile as it can be, and en prise; and a king that's under
+                // full attack.
+                if (!attack_eval)
+                    continue;
+                for (int shape = KNIGHT; shape <= QUEEN; shape++)
+                    value_lazy[color][shape][x][y] +=
+                        mobility[shape] * magnitude(value_mobility[shape]) +
+                        magnitude(value_hanging);
+                value_lazy[color][KING][x][y] +=
+                    magnitude(value_king_attacked[15]);
+            }
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                magnitude()                                 |
+\*----------------------------------------------------------------------------*/
+score_t board_heuristic::magnitude(score_t s)
+{
+
+/// Return a score's middlegame and endgame parts, both made positive.
+
+    return SCORE(ABS(SCORE_MG(s)), ABS(SCORE_EG(s)));
+}
+
 /*----------------------------------------------------------------------------*\
  |                               precomp_pawn()                               |
 \*----------------------------------------------------------------------------*/
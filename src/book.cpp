@@ -28,13 +28,12 @@ using namespace std;
 /*----------------------------------------------------------------------------*\
  |                                   book()                                   |
 \*----------------------------------------------------------------------------*/
-book::book(table *t, string file_name, int n)
+book::book(string file_name, int n)
 {
     ifstream stream;     // The PGN opening book file stream.
     list<string> tokens; // The token list.
 
     board_ptr = new board_heuristic();
-    table_ptr = t;
     num_moves = n;
 
     stream.open(file_name.c_str());  // Open the PGN file.
@@ -50,12 +49,28 @@ void book::read()
 {
 
 /// At this point, we've already populated the game list.  Now, we're actually
-/// starting a new game.  Based on the game list, populate the transposition
-/// table.
+/// starting a new game.  Based on the game list, populate the book move table.
 
     populate_table();
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                  probe()                                   |
+\*----------------------------------------------------------------------------*/
+bool book::probe(bitboard_t hash, Move *move_ptr) const
+{
+
+/// Does the book prescribe a move for the position described in hash?  If so,
+/// then save it to the memory pointed to by move_ptr and return success.  If
+/// not, then return failure.
+
+    map<bitboard_t, Move>::const_iterator it = table.find(hash);
+    if (it == table.end())
+        return false;
+    *move_ptr = it->second;
+    return true;
+}
+
 /*----------------------------------------------------------------------------*\
  |                             populate_tokens()                              |
 \*----------------------------------------------------------------------------*/
@@ -103,6 +118,9 @@ void book::populate_games(list<string>& tokens)
         moves.push_back(move);
         board_ptr->make(move);
     }
+    // The last game has no tags after it to end it - don't forget it.
+    if (!moves.empty())
+        games.push_front(moves);
     board_ptr->set_board();
 }
 
@@ -112,7 +130,9 @@ void book::populate_games(list<string>& tokens)
 void book::populate_table()
 {
 
-/// Based on the game list, populate the transposition table.
+/// Based on the game list, populate the book move table.  (The book used to
+/// live in the transposition table, where the search's results could evict
+/// it.)  Where games disagree on a position, the first game to reach it wins.
 
     list<list<Move> >::iterator game;
     list<Move> moves;
@@ -125,7 +145,7 @@ void book::populate_table()
         {
             if (board_ptr->get_num_moves() >= num_moves)
                 break;
-            table_ptr->store(board_ptr->get_hash(), MAX_DEPTH, BOOK, *move);
+            table.insert(make_pair(board_ptr->get_hash(), *move));
             board_ptr->make(*move);
         }
         board_ptr->set_board();
@@ -60,9 +60,18 @@ ConfigFile::ConfigFile() {
   // Setting default values
   items["engine"] = SEARCH_ENGINE;
   items["xpos_table_mb"] = STRINGIFY(XPOS_TABLE_MB);
+  items["numa_interleave"] = "false";
+  items["xpos_table_file"] = "";
+  items["pawn_table_mb"] = STRINGIFY(PAWN_TABLE_MB);
+  items["eval_table_mb"] = STRINGIFY(EVAL_TABLE_MB);
+  items["lazy_eval"] = "false";
+  items["attack_eval"] = "false";
   items["book_name"] = BOOK_NAME;
   items["book_moves"] = STRINGIFY(BOOK_MOVES); // in plies
   items["overhead"] = STRINGIFY(OVERHEAD); // in centiseconds
+  items["threads"] = STRINGIFY(SEARCH_THREADS);
+  items["smp_mode"] = SMP_MODE;
+  items["multipv"] = STRINGIFY(MULTI_PV);
 
 #ifdef SVN_REV
 	items["svn_version"] = SVN_REV;
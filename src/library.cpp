@@ -22,6 +22,33 @@
 #include "library.h"
 #include <iostream>
 
+#if defined(LINUX) || defined(OS_X)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(LINUX)
+#include <sys/syscall.h>
+
+// NUMA memory policy constants, from <numaif.h> (which comes with libnuma):
+#define MPOL_INTERLEAVE     3
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#endif
+
+// Huge page size (on x86-64, at least):
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// The least memory worth waking up another thread to clear:
+#define CLEAR_CHUNK_SIZE (16 * 1024 * 1024)
+
+/// One thread's share of memory_clear().
+typedef struct clear_chunk
+{
+    char *ptr;   ///< Where the share starts.
+    size_t size; ///< How long it is.
+} clear_chunk_t;
+
 //fast bit index lookup assistance
 //static const int MultiplyDeBruijnBitPosition[32] = 
 //{
@@ -107,6 +134,24 @@ int thread_destroy(thread_t *thread)
     return CRITICAL; // This should never be reached.
 }
 
+/*----------------------------------------------------------------------------*\
+ |                               thread_cpus()                                |
+\*----------------------------------------------------------------------------*/
+int thread_cpus()
+{
+
+// Return the number of processors online (at least 1).
+
+#if defined(LINUX) || defined(OS_X)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (int) cpus;
+#elif defined(_MINGW_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors < 1 ? 1 : (int) info.dwNumberOfProcessors;
+#endif
+}
+
 /*----------------------------------------------------------------------------*\
  |                               mutex_create()                               |
 \*----------------------------------------------------------------------------*/
@@ -284,6 +329,172 @@ int cond_destroy(cond_t *cond)
 #endif
 }
 
+/*----------------------------------------------------------------------------*\
+ |                               memory_alloc()                               |
+\*----------------------------------------------------------------------------*/
+void *memory_alloc(size_t size, bool interleave)
+{
+
+// Allocate a large, page-aligned, zero-filled block of memory (for a hash
+// table).  Hash tables are probed at random, so back the block with huge pages
+// if the OS will let us, to spare the TLB: first ask for explicitly reserved
+// huge pages, then fall back to ordinary pages and advise the kernel to use
+// transparent huge pages for them.  If interleave is set, then also spread the
+// block's pages across all of our NUMA nodes, so that on a multi-socket host
+// no one node's memory controller serves every probe.  Return NULL if we're
+// out of memory.
+
+#if defined(LINUX) || defined(OS_X)
+    void *ptr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (size % HUGE_PAGE_SIZE == 0)
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED)
+    {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return NULL;
+#if defined(MADV_HUGEPAGE)
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    }
+#if defined(LINUX)
+    // There's no NUMA API in libc, and we'd rather not drag in libnuma, so
+    // make the system calls ourselves: find which nodes we may allocate on,
+    // then (if there's more than one) interleave the block across them.  If
+    // either call fails, then the block just stays on whichever node first
+    // touches it.
+    unsigned long nodes = 0;
+    if (interleave &&
+        !syscall(SYS_get_mempolicy, NULL, &nodes, sizeof(nodes) * 8, NULL,
+                 MPOL_F_MEMS_ALLOWED) && (nodes & (nodes - 1)))
+        syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, &nodes,
+                sizeof(nodes) * 8, 0);
+#endif
+    return ptr;
+#elif defined(_MINGW_WINDOWS)
+    // Windows only grants large pages to processes holding the "lock pages in
+    // memory" privilege, and has no interleave policy to speak of.
+    void *ptr = NULL;
+    SIZE_T large = GetLargePageMinimum();
+    if (large && size % large == 0)
+        ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT |
+                           MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (ptr == NULL)
+        ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT,
+                           PAGE_READWRITE);
+    return ptr;
+#endif
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               memory_free()                                |
+\*----------------------------------------------------------------------------*/
+void memory_free(void *ptr, size_t size)
+{
+
+// Free a block of memory of the specified size allocated by memory_alloc().
+
+#if defined(LINUX) || defined(OS_X)
+    munmap(ptr, size);
+#elif defined(_MINGW_WINDOWS)
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#endif
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               clear_start()                                |
+\*----------------------------------------------------------------------------*/
+static void *clear_start(void *arg)
+{
+
+// Clear one thread's share of memory_clear().
+
+    clear_chunk_t *chunk = (clear_chunk_t *) arg;
+    memset(chunk->ptr, 0, chunk->size);
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               memory_clear()                               |
+\*----------------------------------------------------------------------------*/
+void memory_clear(void *ptr, size_t size)
+{
+
+// Zero a large block of memory.  A single thread can't saturate the memory
+// bus, so split the block into page-aligned chunks (at least CLEAR_CHUNK_SIZE
+// each) and zero them on as many threads as we have processors.
+
+    int threads = thread_cpus();
+    if ((size_t) threads > size / CLEAR_CHUNK_SIZE)
+        threads = (int) (size / CLEAR_CHUNK_SIZE);
+    if (threads > 64)
+        threads = 64;
+    if (threads < 2)
+    {
+        memset(ptr, 0, size);
+        return;
+    }
+
+    thread_t thread[64];
+    clear_chunk_t chunk[64];
+    size_t share = (size / threads) & ~(size_t) 4095;
+    for (int j = 0; j < threads; j++)
+    {
+        chunk[j].ptr = (char *) ptr + j * share;
+        chunk[j].size = j < threads - 1 ? share : size - j * share;
+    }
+    for (int j = 1; j < threads; j++)
+        thread_create(&thread[j], (entry_t) clear_start, &chunk[j]);
+    clear_start(&chunk[0]);
+    for (int j = 1; j < threads; j++)
+        thread_wait(&thread[j]);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             memory_map_file()                              |
+\*----------------------------------------------------------------------------*/
+void *memory_map_file(const char *path, size_t size, bool *created)
+{
+
+// Map a file of the specified size into memory, shared with every other
+// process that maps it, so that whatever we write to the memory ends up in the
+// file.  If the file doesn't exist (or is empty), then create it zero-filled
+// and set *created.  Return NULL if we can't open the file, or it's the wrong
+// size.  Free the memory with memory_free().
+
+#if defined(LINUX) || defined(OS_X)
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+        return NULL;
+    if (fstat(fd, &st) == -1 ||
+        (st.st_size && (size_t) st.st_size != size) ||
+        (!st.st_size && ftruncate(fd, size) == -1))
+    {
+        close(fd);
+        return NULL;
+    }
+    *created = !st.st_size;
+
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return NULL;
+#if defined(MADV_RANDOM)
+    madvise(ptr, size, MADV_RANDOM);
+#endif
+    return ptr;
+#elif defined(_MINGW_WINDOWS)
+    // XXX: We should probably use CreateFileMapping() here.  Until then,
+    // Windows users get a fresh table every time.
+    return NULL;
+#endif
+}
+
 // Global variables:
 void (*callback)(void*);
 void *callback_data;
@@ -427,6 +638,24 @@ int timer_cancel()
 #endif
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                timer_now()                                 |
+\*----------------------------------------------------------------------------*/
+uint64_t timer_now()
+{
+
+// Return the wall clock time (in milliseconds).  Unlike clock(), this counts
+// time spent waiting on other threads, and none spent on them.
+
+#if defined(LINUX) || defined(OS_X)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#elif defined(_MINGW_WINDOWS)
+    return GetTickCount();
+#endif
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 rand_64()                                  |
 \*----------------------------------------------------------------------------*/
@@ -444,17 +673,38 @@ uint64_t rand_64()
 #endif
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                 rand_64()                                  |
+\*----------------------------------------------------------------------------*/
+uint64_t rand_64(uint64_t *state)
+{
+
+// Generate a 64-bit pseudo-random number from (and advance) the specified
+// state.  Unlike rand_64() above, the same starting state always produces the
+// same sequence, on every platform.  (This is SplitMix64.)
+
+    uint64_t n = (*state += 0x9E3779B97F4A7C15ULL);
+    n = (n ^ (n >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    n = (n ^ (n >> 27)) * 0x94D049BB133111EBULL;
+    return n ^ (n >> 31);
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 count_64()                                 |
  |   Count the number of set bits in a 64-bit integer.
 \*----------------------------------------------------------------------------*/
 int count_64(uint64_t n)
 {
+#if defined(__POPCNT__)
+    // The processor can count them itself.
+    return __builtin_popcountll(n);
+#else
     n = n - ((n >> 1) & (uint64_t)~(uint64_t)0/3);
     n = (n & (uint64_t)~(uint64_t)0/15*3) + 
                      ((n >> 2) & (uint64_t)~(uint64_t)0/15*3);
     n = (n + (n >> 4)) & (uint64_t)~(uint64_t)0/255*15;   
     return (uint64_t)(n * ((uint64_t)~(uint64_t)0/255)) >> (sizeof(n) - 1) * 8;
+#endif
 }
 
 // These next two functions, we shamelessly yoinked from the GNU C Library,
@@ -24,6 +24,7 @@
 #include "configfile.h"
 #include "testing.h"
 #include "xboard.h"
+#include "board_heuristic.h"
 #include "search_mtdf.h"
 
 using namespace std;
@@ -101,6 +102,19 @@ int main(int argc, char **argv)
             config.set("overhead", iOverhead);
             break;
           }
+        case 't':
+          {
+            // Specifying the number of search threads.
+            int iThreads = atoi(&argv[i][2]);
+            if (iThreads < 1)
+            {
+                cerr << "number of search threads must be >= 1" << endl;
+                exit(EXIT_FAILURE);
+            }
+            cout << "Setting search threads to " << iThreads << endl;
+            config.set("threads", iThreads);
+            break;
+          }
         case 'p':
           {
             // Specifying correctness and performance tests.
@@ -132,7 +146,26 @@ int main(int argc, char **argv)
 
     // Instantiate the classes.
     /// Transposition table object.
-    table t(config.getInt("xpos_table_mb"));
+    table t(config.getInt("xpos_table_mb"),
+            config.getString("numa_interleave") == "true",
+            config.getString("xpos_table_file"));
+    /// Pawn tables (one per search thread, allocated as needed) - just size
+    /// them.
+    if (config.getInt("pawn_table_mb") < 1)
+    {
+        cerr << "pawn table must be >= 1 MB" << endl;
+        exit(EXIT_FAILURE);
+    }
+    board_heuristic::set_pawn_table_mb(config.getInt("pawn_table_mb"));
+    /// Eval tables (likewise).
+    if (config.getInt("eval_table_mb") < 1)
+    {
+        cerr << "eval table must be >= 1 MB" << endl;
+        exit(EXIT_FAILURE);
+    }
+    board_heuristic::set_eval_table_mb(config.getInt("eval_table_mb"));
+    board_heuristic::set_lazy_eval(config.getString("lazy_eval") == "true");
+    board_heuristic::set_attack_eval(config.getString("attack_eval") == "true");
     /// History table object.
     history h;
     /// Chess clock object.
@@ -140,7 +173,7 @@ int main(int argc, char **argv)
     /// XBoard object.
     xboard x;
     /// Opening book object.
-    book o(&t, config.getString("book_name"), config.getInt("book_moves"));
+    book o(config.getString("book_name"), config.getInt("book_moves"));
 
     // Based on the -s command-line option, choose the move search engine
     // and cast it as a generic version.  Thus far, we've only implemented
@@ -148,6 +181,18 @@ int main(int argc, char **argv)
     search_base *s = 0;
     if (config.getString("engine") == "MTD(f)")
         s = new search_mtdf(&t, &h, &c, &x);
+    s->set_book(&o);
+    s->set_threads(config.getInt("threads"));
+    s->set_multipv(config.getInt("multipv"));
+    if (config.getString("smp_mode") == "ybwc")
+        s->set_smp_mode(SMP_YBWC);
+    else if (config.getString("smp_mode") == "root")
+        s->set_smp_mode(SMP_ROOT);
+    else if (config.getString("smp_mode") != "shared")
+    {
+        cerr << "parallel search mode must be shared, ybwc or root" << endl;
+        exit(EXIT_FAILURE);
+    }
 
     // Launch the event loop.
     x.loop(s, &c, &o);
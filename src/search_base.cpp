@@ -19,6 +19,7 @@
  | this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gray.h"
 #include "search_base.h"
 #include "board_heuristic.h"
 #include "clock.h"
@@ -36,27 +37,42 @@ string search_base::debug_pv_prefix = "";
 /*----------------------------------------------------------------------------*\
  |                               search_base()                                |
 \*----------------------------------------------------------------------------*/
-search_base::search_base(table *t, history *h, chess_clock *c, xboard *x)
+search_base::search_base(table *t, history *h, chess_clock *c, xboard *x,
+                         int id)
 {
 
 /// Constructor.  Important!  Seed the random number generator - issue
 /// <code>srand(time(NULL));</code> - before instantiating this class!
+///
+/// The id is 0 for the main search.  Helper searches (numbered from 1) share
+/// the transposition table but never answer to the clock.
 
     max_depth = MAX_DEPTH;
     output = false;
+    multipv = 1;
     correct_guesses = 0;
     total_guesses = 0;
+    thread_id = id;
+    num_threads = 1;
+    memory_mb = 0;
+    searching = false;
+    search_status = IDLING;
+    token_update = 0;
 
     board_ptr = new board_heuristic();
     table_ptr = t;
     history_ptr = h;
     clock_ptr = c;
     xboard_ptr = x;
+    book_ptr = NULL;
+    inBook = true;
 
     mutex_create(&timeout_mutex);
-    clock_ptr->set_callback((clock_callback_t) _handle, this);
+    if (!thread_id)
+        clock_ptr->set_callback((clock_callback_t) _handle, this);
     mutex_create(&search_mutex);
     cond_create(&search_cond, NULL);
+    cond_create(&idle_cond, NULL);
     thread_create(&search_thread, (entry_t) _start, this);
 }
 
@@ -68,6 +84,7 @@ search_base::~search_base()
 
 /// Destructor.
 
+    cond_destroy(&idle_cond);
     cond_destroy(&search_cond);
     mutex_destroy(&search_mutex);
     mutex_destroy(&timeout_mutex);
@@ -118,6 +135,17 @@ thread_t search_base::get_thread() const
     return search_thread;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                get_status()                                |
+\*----------------------------------------------------------------------------*/
+int search_base::get_status() const
+{
+
+/// Return the search status that we've most recently been asked for.
+
+    return search_status;
+}
+
 /*----------------------------------------------------------------------------*\
  |                                set_depth()                                 |
 \*----------------------------------------------------------------------------*/
@@ -140,6 +168,107 @@ void search_base::set_output(bool o)
     output = o;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                               set_multipv()                                |
+\*----------------------------------------------------------------------------*/
+void search_base::set_multipv(int n)
+{
+
+/// Set how many principal variations (each starting with a different move) to
+/// report when analyzing.
+
+    multipv = GREATER(1, LESSER(n, MAX_MOVES_PER_TURN));
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               set_threads()                                |
+\*----------------------------------------------------------------------------*/
+void search_base::set_threads(int n)
+{
+
+/// Set the number of search threads (from the next search on).  The base
+/// search is single-threaded; searches that can share the work override this.
+
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               get_threads()                                |
+\*----------------------------------------------------------------------------*/
+int search_base::get_threads() const
+{
+
+/// Return the number of search threads that we've been asked for.
+
+    return num_threads;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               set_smp_mode()                               |
+\*----------------------------------------------------------------------------*/
+void search_base::set_smp_mode(int m)
+{
+
+/// Set how the search threads share the work.  The base search is
+/// single-threaded; searches that can share the work override this.
+
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                set_memory()                                |
+\*----------------------------------------------------------------------------*/
+void search_base::set_memory(int mb)
+{
+
+/// Resize the hash tables to fit in the specified size (in MB) between them.
+/// Each search thread's pawn and eval tables get the sizes asked for in the
+/// config file, unless they'd take up more than an eighth (pawn) or a
+/// sixteenth (eval) of the total between them; the transposition table gets
+/// the rest.  We size for the number of threads asked for, rather than the
+/// number running now, since that's how many there'll be by the next search -
+/// and we remember the budget, so that we can split it up again if the number
+/// of threads changes.  Only do this while the search thread is idling (see
+/// wait_idle()).
+
+    int threads = get_threads();
+    int pawn_mb = LESSER(board_heuristic::get_pawn_table_mb(),
+                         mb / 8 / threads);
+    pawn_mb = GREATER(pawn_mb, 1);
+    int eval_mb = LESSER(board_heuristic::get_eval_table_mb(),
+                         mb / 16 / threads);
+    eval_mb = GREATER(eval_mb, 1);
+    int xpos_mb = GREATER(mb - (pawn_mb + eval_mb) * threads, 1);
+
+    memory_mb = mb;
+    board_heuristic::fit_tables(pawn_mb, eval_mb);
+    if (xpos_mb != table_ptr->get_mb())
+        table_ptr->resize(xpos_mb);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                 set_book()                                 |
+\*----------------------------------------------------------------------------*/
+void search_base::set_book(book *b)
+{
+
+/// Set the opening book to consult before thinking.
+
+    book_ptr = b;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                wait_idle()                                 |
+\*----------------------------------------------------------------------------*/
+void search_base::wait_idle()
+{
+
+/// Wait until the search thread has processed every request and is idling.
+
+    mutex_lock(&search_mutex);
+    while (searching || token_update)
+        cond_wait(&idle_cond, &search_mutex);
+    mutex_unlock(&search_mutex);
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 move_now()                                 |
 \*----------------------------------------------------------------------------*/
@@ -204,12 +333,20 @@ void search_base::change(int s, const board_base& now)
     // the board.
 	board_ptr->lock();
 	*board_ptr = now;
-	extract_pv();
-	extract_hint(s);
+	if (!thread_id)
+	{
+		shift_pv();
+		extract_hint(s);
+	}
 	board_ptr->unlock();
 
-    // Send the command to think.
+    // Send the command to think.  Force the timeout once more while we hold
+    // the search lock: if the search thread picked up the previous command
+    // after we forced the timeout above, it'll now stop and pick up this one.
     mutex_lock(&search_mutex);
+    mutex_lock(&timeout_mutex);
+    timeout_flag = true;
+    mutex_unlock(&timeout_mutex);
 #ifndef _MSDEV_WINDOWS
     DEBUG_SEARCH_PRINTA("search_base::change changes state from %s to %s.",
         status_to_string(search_status).c_str(), status_to_string(s).c_str());
@@ -263,33 +400,44 @@ void search_base::start()
 /// status or the board to change, then do the requested work.  Rinse, lather,
 /// and repeat, until XBoard commands us to quit.
 
-    search_status = IDLING;
+    int status;
 
     do
     {
-        // Wait for either the status or the board to change.
+        // Wait for either the status or the board to change.  Clear the
+        // timeout under the same lock that change() forces it under, so that
+        // a request can never slip in between the two.
         mutex_lock(&search_mutex);
         while (!token_update)
             cond_wait(&search_cond, &search_mutex);
         token_update = 0;
+        status = search_status;
+        searching = status == ANALYZING ||
+                    status == THINKING  ||
+                    status == PONDERING;
+        if (searching)
+        {
+            mutex_lock(&timeout_mutex);
+            timeout_flag = false;
+            mutex_unlock(&timeout_mutex);
+        }
         mutex_unlock(&search_mutex);
 
         // Do the requested work - idle, analyze, think, ponder, or quit.
 #ifndef _MSDEV_WINDOWS
         bitboard_t board_hash = board_ptr->get_hash();
         DEBUG_SEARCH_PRINTA("search_base::start doing requested work (hash = %llx, status = %s).",
-            (long long unsigned)board_hash, status_to_string(search_status).c_str());
+            (long long unsigned)board_hash, status_to_string(status).c_str());
 #endif
 
-        if (search_status == ANALYZING ||
-            search_status == THINKING  ||
-            search_status == PONDERING)
-        {
-            mutex_lock(&timeout_mutex);
-            timeout_flag = false;
-            mutex_unlock(&timeout_mutex);
-            iterate(search_status);
-        }
+        if (searching)
+            iterate(status);
+
+        // Let whoever's waiting for us to go idle know that we have.
+        mutex_lock(&search_mutex);
+        searching = false;
+        cond_broadcast(&idle_cond);
+        mutex_unlock(&search_mutex);
     } while (search_status != QUITTING);
 
     thread_destroy(NULL);
@@ -304,10 +452,11 @@ void search_base::extract_pv()
     Move m;
     pv.clear();
 
-    for (table_ptr->probe(board_ptr->get_hash(), 0, EXACT, &m); 
+    for (table_ptr->probe(board_ptr->get_hash(), 0, &m); 
          !m.is_null() && board_ptr->get_status(true) == IN_PROGRESS;
-         table_ptr->probe(board_ptr->get_hash(), 0, EXACT, &m))
+         table_ptr->probe(board_ptr->get_hash(), 0, &m))
     {
+        pv_hashes[pv.size()] = board_ptr->get_hash();
         pv.addMove(m);
         board_ptr->make(m);
         if (pv.size() == (unsigned) max_depth)
@@ -317,6 +466,33 @@ void search_base::extract_pv()
         board_ptr->unmake();
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                 shift_pv()                                 |
+\*----------------------------------------------------------------------------*/
+void search_base::shift_pv()
+{
+
+/// The board has just been set to a new position.  If the position is along
+/// the principal variation (because the moves we expected have been made), then
+/// drop the moves that led to it.  Otherwise, the principal variation has
+/// nothing to say about it.
+
+    bitboard_t hash = board_ptr->get_hash();
+
+    for (unsigned k = 0; k < pv.size(); k++)
+        if (pv_hashes[k] == hash)
+        {
+            for (unsigned j = k; j < pv.size(); j++)
+            {
+                pv.theArray[j - k] = pv.theArray[j];
+                pv_hashes[j - k] = pv_hashes[j];
+            }
+            pv.mNumElements -= k;
+            return;
+        }
+    pv.clear();
+}
+
 /*----------------------------------------------------------------------------*\
  |                               extract_hint()                               |
 \*----------------------------------------------------------------------------*/
@@ -374,4 +550,5 @@ void search_base::reset()
 {
   table_ptr->clear();
   history_ptr->clear();
+  inBook = true;
 }
@@ -21,6 +21,8 @@
 
 #include "gray.h"
 #include "board_base.h"
+#include "board_heuristic.h"
+#include "book.h"
 #include "search_mtdf.h"
 
 /*----------------------------------------------------------------------------*\
@@ -29,10 +31,59 @@
 search_mtdf::search_mtdf(table* t, history* h, chess_clock* c, xboard* x) :
 search_base(t, h, c, x)
 {
-  MoveArrays = new MoveArray[MAX_DEPTH];
 
 /// Constructor.
 
+    master = this;
+    init();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               search_mtdf()                                |
+\*----------------------------------------------------------------------------*/
+search_mtdf::search_mtdf(search_mtdf* m, int id) :
+search_base(m->table_ptr, new history(), m->clock_ptr, m->xboard_ptr, id)
+{
+
+/// Helper constructor.  A helper has its own board, move stacks, history,
+/// killers and countermoves, but shares the master's transposition table.
+
+    master = m;
+    init();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                   init()                                   |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::init()
+{
+
+/// Initialize everything the constructors have in common.
+
+    MoveArrays = new MoveArray[MAX_DEPTH];
+    threads_wanted = 1;
+    smp_mode = SMP_SHARED;
+    lines = 1;
+
+    clear_killers();
+    for (int color = WHITE; color <= BLACK; color++)
+        for (int from = 0; from < 64; from++)
+            for (int to = 0; to < 64; to++)
+                countermoves[color][from][to].set_null();
+
+    // Our split points' boards are only allocated once we split at their
+    // plies.
+    for (int depth = 0; depth < MAX_DEPTH; depth++)
+    {
+        splits[depth].board = NULL;
+        mutex_create(&splits[depth].mutex);
+        cond_create(&splits[depth].cond, NULL);
+    }
+    active_split = NULL;
+    mutex_create(&pool_mutex);
+    cond_create(&pool_cond, NULL);
+    pool_size = 0;
+    idle_workers = 0;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -40,10 +91,29 @@ search_base(t, h, c, x)
 \*----------------------------------------------------------------------------*/
 search_mtdf::~search_mtdf()
 {
-  delete MoveArrays;
 
 /// Destructor.
 
+    if (thread_id)
+    {
+        delete history_ptr;
+        delete board_ptr;
+    }
+    else
+    {
+        set_threads(1);
+        adjust_helpers();
+    }
+
+    for (int depth = 0; depth < MAX_DEPTH; depth++)
+    {
+        delete splits[depth].board;
+        cond_destroy(&splits[depth].cond);
+        mutex_destroy(&splits[depth].mutex);
+    }
+    cond_destroy(&pool_cond);
+    mutex_destroy(&pool_mutex);
+    delete[] MoveArrays;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -59,11 +129,722 @@ search_mtdf& search_mtdf::operator=(const search_mtdf& that)
     return *this;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                  reset()                                   |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::reset()
+{
+
+/// Forget everything learned during previous games: the transposition and
+/// history tables, and the killer and countermove tables (ours and our
+/// helpers').
+
+    if (thread_id)
+        history_ptr->clear();
+    else
+        search_base::reset();
+    clear_killers();
+    for (int color = WHITE; color <= BLACK; color++)
+        for (int from = 0; from < 64; from++)
+            for (int to = 0; to < 64; to++)
+                countermoves[color][from][to].set_null();
+    for (int id = 1; id < num_threads; id++)
+        helpers[id]->reset();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               set_threads()                                |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::set_threads(int n)
+{
+
+/// Set the number of search threads.  We never add or remove helpers in the
+/// middle of a search, so this takes effect when the next search starts.
+
+    threads_wanted = GREATER(1, LESSER(n, MAX_THREADS));
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               get_threads()                                |
+\*----------------------------------------------------------------------------*/
+int search_mtdf::get_threads() const
+{
+
+/// Return the number of search threads that we've been asked for (which is
+/// how many there'll be once the next search starts).
+
+    return threads_wanted;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               set_smp_mode()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::set_smp_mode(int m)
+{
+
+/// Set how the search threads share the work: either every thread searches the
+/// whole tree and they cooperate through the transposition table, or helpers
+/// search younger brothers at split points, or every thread searches its own
+/// share of the root moves (with a full window each).
+
+    smp_mode = m;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              adjust_helpers()                              |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::adjust_helpers()
+{
+
+/// Create or destroy helpers until we have as many search threads as we've
+/// been asked for.  Only call this between searches.
+
+    for (; num_threads < threads_wanted; num_threads++)
+        helpers[num_threads] = new search_mtdf(this, num_threads);
+    for (; num_threads > threads_wanted; num_threads--)
+    {
+        search_mtdf *helper = helpers[num_threads - 1];
+        thread_t thread = helper->get_thread();
+        helper->change(QUITTING, *board_ptr);
+        thread_wait(&thread);
+        delete helper;
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              start_helpers()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::start_helpers()
+{
+
+/// Set our helpers loose on the position we're about to search.
+
+    for (int id = 1; id < num_threads; id++)
+    {
+        helpers[id]->nodes = 0;
+        ((board_heuristic *) helpers[id]->board_ptr)->reset_eval_counts();
+        helpers[id]->change(ANALYZING, *board_ptr);
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               stop_helpers()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::stop_helpers()
+{
+
+/// Call off our helpers, and don't return until they've all stopped (so that
+/// none of them is still writing to the transposition table behind our back).
+
+    for (int id = 1; id < num_threads; id++)
+        helpers[id]->handle();
+    mutex_lock(&pool_mutex);
+    cond_broadcast(&pool_cond);
+    mutex_unlock(&pool_mutex);
+    for (int id = 1; id < num_threads; id++)
+    {
+        helpers[id]->change(IDLING, *board_ptr);
+        helpers[id]->wait_idle();
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               helper_nodes()                               |
+\*----------------------------------------------------------------------------*/
+int search_mtdf::helper_nodes() const
+{
+
+/// Total the number of nodes our helpers have searched so far.
+
+    int total = 0;
+    for (int id = 1; id < num_threads; id++)
+        total += helpers[id]->nodes;
+    return total;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                eval_hits()                                 |
+\*----------------------------------------------------------------------------*/
+int search_mtdf::eval_hits() const
+{
+
+/// Work out how many of this search's evaluations (ours and our helpers') the
+/// eval tables have answered so far, in permille - or -1 if there haven't been
+/// any evaluations yet.
+
+    const board_heuristic *b = (const board_heuristic *) board_ptr;
+    uint64_t hits = b->get_eval_hits();
+    uint64_t probes = hits + b->get_eval_misses();
+    for (int id = 1; id < num_threads; id++)
+    {
+        b = (const board_heuristic *) helpers[id]->board_ptr;
+        hits += b->get_eval_hits();
+        probes += b->get_eval_hits() + b->get_eval_misses();
+    }
+    return probes ? (int) (hits * 1000 / probes) : -1;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                   work()                                   |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::work()
+{
+
+/// Young Brothers Wait (or root move parallelism).  Wait for the master's
+/// search (or another helper's) to open a split point, join it, and search its
+/// moves until there are none left.  Then look for another, until we're called
+/// off.
+
+    board_ptr->lock();
+    clear_killers();
+
+    mutex_lock(&master->pool_mutex);
+    while (!timeout_flag && !master->timeout_flag)
+    {
+        // Steal from the open split point with the most moves left.
+        split_point_t *sp = NULL;
+        for (int j = 0; j < master->pool_size; j++)
+        {
+            split_point_t *open = master->pool[j];
+            if (!open->cutoff && open->next < open->moves->mNumElements &&
+                (!sp || open->moves->mNumElements - open->next >
+                        sp->moves->mNumElements - sp->next))
+                sp = open;
+        }
+        if (!sp)
+        {
+            master->idle_workers++;
+            cond_wait(&master->pool_cond, &master->pool_mutex);
+            master->idle_workers--;
+            continue;
+        }
+
+        // Sign up while the split point is still open (its owner can't close
+        // it without the pool lock), then get to work on our own copy of its
+        // position.
+        mutex_lock(&sp->mutex);
+        sp->workers++;
+        mutex_unlock(&sp->mutex);
+        mutex_unlock(&master->pool_mutex);
+
+        *board_ptr = *sp->board;
+        max_depth = sp->max_depth;
+        for (int j = 1; j < sp->depth; j++)
+        {
+            line[j] = sp->line[j];
+            line_piece[j] = sp->line_piece[j];
+        }
+        active_split = sp;
+        search_split(sp);
+        active_split = NULL;
+
+        mutex_lock(&sp->mutex);
+        if (!--sp->workers)
+            cond_signal(&sp->cond);
+        mutex_unlock(&sp->mutex);
+        mutex_lock(&master->pool_mutex);
+    }
+    mutex_unlock(&master->pool_mutex);
+
+    board_ptr->unlock();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                 stopped()                                  |
+\*----------------------------------------------------------------------------*/
+bool search_mtdf::stopped() const
+{
+
+/// Should we stop searching?  Yes, if we've been called off, if the master's
+/// search has been called off, or if a move has failed high at any of the split
+/// points that we're working for (in which case the rest of our work is moot).
+
+    if (timeout_flag || master->timeout_flag)
+        return true;
+    for (split_point_t *sp = active_split; sp; sp = sp->parent)
+        if (sp->cutoff)
+            return true;
+    return false;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                   make()                                   |
+\*----------------------------------------------------------------------------*/
+bool search_mtdf::make(int depth, Move m)
+{
+
+/// Make a move on our board at the specified ply (noting it in our line), and
+/// return whether it's a capture.  The child node will probe the transposition
+/// table at some random address, so start fetching that now - the legality
+/// checks and other bookkeeping before the probe will hide most of the wait.
+/// (Our board does the same for its pawn table.)
+
+    line[depth] = m;
+    line_piece[depth] = piece_square(m);
+    bool capture = board_ptr->make(m);
+    table_ptr->prefetch(board_ptr->get_hash());
+    return capture;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               piece_square()                               |
+\*----------------------------------------------------------------------------*/
+int search_mtdf::piece_square(Move m) const
+{
+
+/// Return the piece-square index (the shape of the piece moved times 64, plus
+/// the square that it moves to) of a move that's about to be made, or -1 if
+/// it's a null move.
+
+    if (m.is_null())
+        return -1;
+    return board_ptr->get_shape(m.x1, m.y1) * 64 + m.x2 + 8 * m.y2;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              history_score()                               |
+\*----------------------------------------------------------------------------*/
+int search_mtdf::history_score(int depth, bool whose, Move m) const
+{
+
+/// Return how well a move at the specified ply has done lately: its history
+/// score, plus its continuation history scores as a follow-up to the moves
+/// made one and two plies before.
+
+    int score = history_ptr->probe(whose, m);
+    int next = piece_square(m);
+    for (int ply = 1; ply <= CONT_PLIES && ply < depth; ply++)
+        if (line_piece[depth - ply] != -1)
+            score += history_ptr->probe_cont(ply, whose,
+                                             line_piece[depth - ply], next);
+    return score;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                can_split()                                 |
+\*----------------------------------------------------------------------------*/
+bool search_mtdf::can_split(int depth) const
+{
+
+/// Is it worth handing out the rest of this node's moves?  Only if there's
+/// someone idle to take them, and enough depth left to pay for the trouble.
+/// (We don't bother with the capture and check extensions.)
+
+    return master->smp_mode == SMP_YBWC && master->idle_workers > 0 &&
+           max_depth - depth >= SPLIT_MIN_DEPTH && !(depth == 1 && lines > 1);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                  split()                                   |
+\*----------------------------------------------------------------------------*/
+Move search_mtdf::split(int depth, int reduction, unsigned first,
+                        value_t alpha, value_t beta, Move best, bool in_check,
+                        bool ranked, const Move *tried, int num_tried)
+{
+
+/// The eldest brother at this ply has been searched.  Open a split point for
+/// his younger brothers (from the first index on), search them alongside
+/// whichever idle helpers join us, and return the best move.
+///
+/// If the split point is ranked, then every move is searched with a full
+/// window and its exact score is left in the move list.  (We use this to
+/// search all of the root moves in parallel.)
+///
+/// If the search at this ply has been reduced (see minimax()), then the
+/// younger brothers' searches are reduced as much.
+///
+/// The tried moves are those that we've already searched here without a
+/// cutoff; the split point adds its own to them, so that whichever move does
+/// cause a cutoff can lower their history scores, as in the serial search.
+
+    split_point_t *sp = &splits[depth];
+    if (!sp->board)
+        sp->board = new board_heuristic();
+    *sp->board = *board_ptr;
+    sp->moves = &MoveArrays[depth];
+    sp->next = first;
+    sp->depth = depth;
+    sp->reduction = reduction;
+    sp->max_depth = max_depth;
+    sp->in_check = in_check;
+    sp->ranked = ranked;
+    sp->alpha = alpha;
+    sp->beta = beta;
+    sp->best = best;
+    sp->best_quiet = false;
+    for (int j = 0; j < num_tried; j++)
+        sp->tried[j] = tried[j];
+    sp->num_tried = num_tried;
+    sp->cutoff = false;
+    sp->workers = 1;
+    sp->parent = active_split;
+    for (int j = depth; j < pv_length[depth]; j++)
+        sp->pv[j] = pv_table[depth][j];
+    sp->pv_length = pv_length[depth];
+    for (int j = 1; j < depth; j++)
+    {
+        sp->line[j] = line[j];
+        sp->line_piece[j] = line_piece[j];
+    }
+
+    // Open the split point, and wake the idle helpers.
+    mutex_lock(&master->pool_mutex);
+    master->pool[master->pool_size++] = sp;
+    cond_broadcast(&master->pool_cond);
+    mutex_unlock(&master->pool_mutex);
+
+    active_split = sp;
+    search_split(sp);
+    active_split = sp->parent;
+
+    // There are no moves left to hand out.  Close the split point, then wait
+    // for the helpers that joined us to finish their moves.
+    mutex_lock(&master->pool_mutex);
+    for (int j = 0; j < master->pool_size; j++)
+        if (master->pool[j] == sp)
+        {
+            master->pool[j] = master->pool[--master->pool_size];
+            break;
+        }
+    mutex_unlock(&master->pool_mutex);
+
+    mutex_lock(&sp->mutex);
+    sp->workers--;
+    while (sp->workers)
+        cond_wait(&sp->cond, &sp->mutex);
+    mutex_unlock(&sp->mutex);
+
+    // Take the best move's line for our own.
+    for (int j = depth; j < sp->pv_length; j++)
+        pv_table[depth][j] = sp->pv[j];
+    pv_length[depth] = sp->pv_length;
+
+    if (sp->cutoff && !stopped())
+        store_cutoff(depth, max_depth - reduction, board_ptr->get_whose(),
+                     sp->best, sp->best_quiet, sp->tried, sp->num_tried);
+    return sp->best;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             rank_root_moves()                              |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::rank_root_moves()
+{
+
+/// Every root move has just been searched with a full window.  Sort the legal
+/// ones, best first, into the ranked root list (remembering where each one
+/// came from, so we can find its line).
+
+    root_moves.clear();
+    for (unsigned i = 0; i < MoveArrays[1].mNumElements; i++)
+        if (ABS(MoveArrays[1].theArray[i].value) != VALUE_ILLEGAL)
+        {
+            root_order[root_moves.size()] = i;
+            root_moves.addMove(MoveArrays[1].theArray[i]);
+        }
+
+    for (unsigned i = 1; i < root_moves.mNumElements; i++)
+    {
+        Move move = root_moves.theArray[i];
+        unsigned index = root_order[i];
+        unsigned j = i;
+        for (; j > 0 && root_moves.theArray[j - 1].value < move.value; j--)
+        {
+            root_moves.theArray[j] = root_moves.theArray[j - 1];
+            root_order[j] = root_order[j - 1];
+        }
+        root_moves.theArray[j] = move;
+        root_order[j] = index;
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                update_pv()                                 |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::update_pv(int depth, Move m)
+{
+
+/// The move m is the best one at this ply so far.  Its line is m followed by
+/// the best line from the next ply.
+
+    pv_table[depth][depth] = m;
+    for (int j = depth + 1; j < pv_length[depth + 1]; j++)
+        pv_table[depth][j] = pv_table[depth + 1][j];
+    pv_length[depth] = pv_length[depth + 1];
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               save_root_pv()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::save_root_pv(unsigned index, Move m)
+{
+
+/// The root move m (at the specified index in the root move list) has just
+/// been searched.  Save its line - for MultiPV, every root move's line counts,
+/// not just the best one's.
+
+    Move *line = master->root_pv[index];
+    int length = 0;
+
+    line[length++] = m;
+    for (int j = 2; j < pv_length[2]; j++)
+        line[length++] = pv_table[2][j];
+    master->root_pv_length[index] = length;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                extract_pv()                                |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::extract_pv()
+{
+
+/// Copy the principal variation out of the triangular PV table, where the last
+/// iteration left it, and note the hash key of each position along it.
+///
+/// The line in the table stops short wherever the search took a score from the
+/// transposition table instead of searching on.  So carry on from there along
+/// the transposition table's best moves - as long as each one is legal, the
+/// line doesn't come back to a position that's already on it, and it fits.
+
+    MoveArray l(MAX_MOVES_PER_TURN);
+    Move m;
+
+    pv.clear();
+    for (int j = 1; j < pv_length[1]; j++)
+    {
+        pv_hashes[pv.size()] = board_ptr->get_hash();
+        pv.addMove(pv_table[1][j]);
+        board_ptr->make(pv_table[1][j]);
+    }
+    while (pv.size() < MAX_DEPTH - 1 &&
+           table_ptr->probe(board_ptr->get_hash(), 0, &m) &&
+           !m.is_null())
+    {
+        bool repeated = false;
+        for (size_t j = 0; j < pv.size() && !repeated; j++)
+            repeated = pv_hashes[j] == board_ptr->get_hash();
+        bool legal = false;
+        board_ptr->generate(l, true);
+        for (unsigned j = 0; j < l.mNumElements && !legal; j++)
+            legal = l.theArray[j] == m;
+        if (repeated || !legal)
+            break;
+        pv_hashes[pv.size()] = board_ptr->get_hash();
+        pv.addMove(m);
+        board_ptr->make(m);
+    }
+    for (size_t j = 0; j < pv.size(); j++)
+        board_ptr->unmake();
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              multipv_alpha()                               |
+\*----------------------------------------------------------------------------*/
+value_t search_mtdf::multipv_alpha(unsigned searched) const
+{
+
+/// MultiPV.  Of the root moves searched so far, return the score of the worst
+/// of the best few (or -infinity if we haven't searched enough of them yet).
+/// A root move has to beat this to make the list.
+
+    value_t best[MAX_MOVES_PER_TURN];
+    int count = 0;
+
+    for (unsigned i = 0; i < searched; i++)
+    {
+        value_t value = MoveArrays[1].theArray[i].value;
+        if (ABS(value) == VALUE_ILLEGAL)
+            continue;
+        int j = LESSER(count, lines - 1);
+        if (count < lines)
+            count++;
+        else if (value <= best[j])
+            continue;
+        for (; j > 0 && best[j - 1] < value; j--)
+            best[j] = best[j - 1];
+        best[j] = value;
+    }
+    return count < lines ? -INFINITY : best[lines - 1];
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               print_lines()                                |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::print_lines(int depth)
+{
+
+/// MultiPV.  Report each of the best few root moves' lines, with its own score.
+
+    MoveArray variation;
+
+    for (unsigned k = 0; k < root_moves.size() && k < (unsigned) lines; k++)
+    {
+        unsigned index = root_order[k];
+        variation.clear();
+        for (int j = 0; j < root_pv_length[index]; j++)
+            variation.addMove(root_pv[index][j]);
+        xboard_ptr->print_output(depth, root_moves.theArray[k].value,
+                                 clock_ptr->get_elapsed(),
+                                 nodes + helper_nodes(), variation);
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               search_split()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::search_split(split_point_t* sp)
+{
+
+/// Search the split point's moves, one at a time, until there are none left
+/// or one of them has failed high.  The owner and the helpers all run this.
+
+    for (;;)
+    {
+        // Take the next move.
+        mutex_lock(&sp->mutex);
+        if (sp->cutoff || sp->next >= sp->moves->mNumElements)
+        {
+            mutex_unlock(&sp->mutex);
+            break;
+        }
+        unsigned index = sp->next++;
+        Move move = sp->moves->theArray[index];
+        value_t alpha = sp->ranked ? -INFINITY : sp->alpha;
+        mutex_unlock(&sp->mutex);
+
+        // Search it.
+        bool capture = make(sp->depth, move);
+        bool check = sp->in_check | board_ptr->check(true) |
+                     board_ptr->check(false);
+        move.value = -minimax(sp->depth + 1, -sp->beta, -alpha,
+                              capture || check, true, sp->reduction).value;
+        board_ptr->unmake();
+        if (stopped())
+            break;
+        if (ABS(move.value) == VALUE_ILLEGAL)
+            continue;
+
+        // Report back.
+        if (sp->ranked)
+            save_root_pv(index, move);
+        mutex_lock(&sp->mutex);
+        if (sp->ranked)
+            sp->moves->theArray[index].value = move.value;
+        if (move.value > sp->best.value)
+        {
+            sp->best = move;
+            sp->best_quiet = !capture && !move.promo;
+            sp->pv[sp->depth] = move;
+            for (int j = sp->depth + 1; j < pv_length[sp->depth + 1]; j++)
+                sp->pv[j] = pv_table[sp->depth + 1][j];
+            sp->pv_length = pv_length[sp->depth + 1];
+            if (move.value > sp->alpha)
+                sp->alpha = move.value;
+            if (sp->beta <= sp->alpha)
+                sp->cutoff = true;
+        }
+        if (!sp->cutoff && sp->num_tried < HISTORY_TRIED)
+            sp->tried[sp->num_tried++] = move;
+        mutex_unlock(&sp->mutex);
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                   help()                                   |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::help()
+{
+
+/// Lazy SMP.  Search the same position as the main search, with our own board,
+/// move stacks, history and killers, and let the shared transposition table do
+/// the cooperating.  Odd helpers start an iteration ahead of even ones so that
+/// the threads don't all search the same depth in lock step.
+
+    board_ptr->lock();
+    clear_killers();
+    for (int depth = 1 + thread_id % 2;
+         depth < (MAX_DEPTH-SPECIAL_SEARCH_DEPTH) && !timeout_flag; depth++)
+    {
+        set_depth(depth);
+        if (ABS(minimax(1).value) >= VALUE_KING)
+            break;
+        history_ptr->age();
+    }
+    board_ptr->unlock();
+}
+
 void search_mtdf::useBook(bool yesno)
 {
   inBook = yesno;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              clear_killers()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::clear_killers()
+{
+    for (int depth = 0; depth < MAX_DEPTH; depth++)
+    {
+        line[depth].set_null();
+        line_piece[depth] = -1;
+        for (int slot = 0; slot < KILLER_SLOTS; slot++)
+            killers[depth][slot].set_null();
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               store_cutoff()                               |
+\*----------------------------------------------------------------------------*/
+void search_mtdf::store_cutoff(int depth, int horizon, bool whose, Move m,
+                               bool quiet, const Move *tried, int num_tried)
+{
+
+/// The move m has just caused a beta cutoff at the specified ply, in a search
+/// to the specified horizon.  Raise its history and continuation history
+/// scores, and lower those of the moves that we tried before it (if any), by
+/// the square of the depth left to search - a cutoff near the root saves far
+/// more work than one near the leaves.  (Our board is back at the cutoff node,
+/// so we can still tell which pieces those moves would have moved.)  We've no
+/// capture ordering, so captures take part in the history too.
+///
+/// If the move is quiet (neither a capture nor a promotion), then also make it
+/// the ply's first killer (bumping the others down a slot), and remember it as
+/// the refutation of the move our opponent made to get here.
+
+    int left = GREATER(horizon - depth, 1);
+    history_ptr->store(whose, m, left * left);
+    for (int j = 0; j < num_tried; j++)
+        history_ptr->store(whose, tried[j], -left * left);
+
+    for (int ply = 1; ply <= CONT_PLIES && ply < depth; ply++)
+    {
+        int prev = line_piece[depth - ply];
+        if (prev == -1)
+            continue;
+        history_ptr->store_cont(ply, whose, prev, piece_square(m),
+                                left * left);
+        for (int j = 0; j < num_tried; j++)
+            history_ptr->store_cont(ply, whose, prev, piece_square(tried[j]),
+                                    -left * left);
+    }
+
+    if (!quiet)
+        return;
+
+    if (killers[depth][0] != m)
+    {
+        for (int slot = KILLER_SLOTS - 1; slot > 0; slot--)
+            killers[depth][slot] = killers[depth][slot - 1];
+        killers[depth][0] = m;
+    }
+
+    if (depth > 1 && !line[depth - 1].is_null())
+    {
+        Move prev = line[depth - 1];
+        countermoves[whose][prev.x1 + 8 * prev.y1][prev.x2 + 8 * prev.y2] = m;
+    }
+}
+
 /*----------------------------------------------------------------------------*\
  |                                 iterate()                                  |
 \*----------------------------------------------------------------------------*/
@@ -77,16 +858,37 @@ bool search_mtdf::iterate(int state)
     Move guess[2], m;
     bool strong_pondering = false;
 
-    // Wait for the board, then grab the board.
+    // If we're a helper, then there's no book, no clock and no output to worry
+    // about - just search (or wait for split points to search).
+    if (thread_id)
+    {
+        if (master->smp_mode != SMP_SHARED)
+            work();
+        else
+            help();
+        return true;
+    }
+
+    // Wait for the board, then grab the board.  Now that we know we're not
+    // in the middle of a search, it's safe to add or remove helpers - and if
+    // that changes the number of threads, to split our memory budget up again.
     board_ptr->lock();
+    int threads = num_threads;
+    adjust_helpers();
+    if (num_threads != threads && memory_mb)
+        set_memory(memory_mb);
+    table_ptr->new_search();
 
     // If we're to think:  For the current position, does the opening book
     // recommend a move? 
-    if ((inBook) && (state == THINKING))
+    if ((inBook) && (state == THINKING) && book_ptr)
     {
-        if (table_ptr->probe(board_ptr->get_hash(), MAX_DEPTH, BOOK, &m))
+        if (book_ptr->probe(board_ptr->get_hash(), &m))
         {
-            // Yes.  Make the move.
+            // Yes.  Make the move.  (Our principal variation is just the book
+            // move.)
+            pv_table[1][1] = m;
+            pv_length[1] = 2;
             extract_pv();
             extract_hint(THINKING);
             board_ptr->unlock();
@@ -127,8 +929,13 @@ bool search_mtdf::iterate(int state)
         board_ptr->make(hint);
     }
 
-    // Initialize the number of nodes searched.
+    // Initialize the number of nodes searched (and of eval table hits), and
+    // forget the killer moves from the previous position.
     nodes = 0;
+    ((board_heuristic *) board_ptr)->reset_eval_counts();
+    clear_killers();
+    lines = state == ANALYZING ? multipv : 1;
+    start_helpers();
     for (int depth = 0; depth <= 1; depth++)
     {
         guess[depth].set_null();
@@ -146,6 +953,7 @@ bool search_mtdf::iterate(int state)
 #endif
         DEBUG_SEARCH_INIT(1, "");
         //guess[depth & 1] = mtdf(depth, guess[depth & 1].value);
+        root_moves.clear();
         guess[depth & 1] = minimax(1);  //start at depth 1 and go deeper
 
         if (timeout_flag) // || guess[depth & 1].is_null())
@@ -164,22 +972,51 @@ bool search_mtdf::iterate(int state)
           switchValue = true;
         }
 
-        if (output)
+        if (output && lines > 1 && root_moves.size())
+            print_lines(depth);
+        else if (output)
         {
             value_t value = m.value;
             if (switchValue && (state == PONDERING))
               value *= -1;
+            // If we're pondering, then our line starts after the move we
+            // think that our opponent will make - show that move first.
+            MoveArray variation;
             if (strong_pondering)
-                pv.addMove(hint);
+                variation.addMove(hint);
+            for (unsigned j = 0; j < pv.size(); j++)
+                variation.addMove(pv.theArray[j]);
             xboard_ptr->print_output(depth,value,           
-                clock_ptr->get_elapsed(), nodes, pv);
-            if (strong_pondering)
-              pv.removeLast();
+                clock_ptr->get_elapsed(), nodes + helper_nodes(), variation);
+            if (root_moves.size())
+                xboard_ptr->print_root_moves(root_moves);
+        }
+        if (output)
+        {
+            xboard_ptr->print_hashfull(table_ptr->hashfull());
+            int permille = eval_hits();
+            if (permille != -1)
+                xboard_ptr->print_eval_hits(permille);
         }
         if (ABS(m.value) >= VALUE_KING)
             // Oops.  The game will be over at this depth.  There's no point in
             // searching deeper.  Eyes on the prize.
             break;
+
+        // Let the next iteration's cutoffs outweigh this one's.
+        history_ptr->age();
+    }
+
+    // Call off the helpers before we touch the board again, and say how much
+    // of the work each thread did.
+    stop_helpers();
+    if (output && num_threads > 1)
+    {
+        int thread_nodes[MAX_THREADS];
+        thread_nodes[0] = nodes;
+        for (int id = 1; id < num_threads; id++)
+            thread_nodes[id] = helpers[id]->nodes;
+        xboard_ptr->print_thread_nodes(num_threads, thread_nodes);
     }
 
     // If we've just finished thinking, then cancel the alarm.
@@ -234,7 +1071,8 @@ Move search_mtdf::mtdf(int depth, value_t guess)
  |                                 minimax()                                  |
 \*----------------------------------------------------------------------------*/
 Move search_mtdf::minimax(int depth, value_t alpha, value_t beta, 
-                            bool specialCase, bool try_null_move)
+                            bool specialCase, bool try_null_move,
+                            int reduction)
 {
 
 /// From the current position, search for the best move.  This method implements
@@ -257,7 +1095,11 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
 /// than the window).  On the other hand, FailSoft returns either an upper bound
 /// (<= alpha) or a lower bound (>= beta) on the exact score.
 ///
-/// This method also implements null move pruning.
+/// This method also implements null move pruning, and late move reductions: a
+/// quiet move far enough down the list, that the history tables don't think
+/// much of, probably won't cause a cutoff - so we search it a ply shallower
+/// first, and only search it fully if it does.  A reduced search looks the
+/// specified number of plies short of max_depth, all the way down.
 
     // Local variables that pertain to the current position:
     bool whose = board_ptr->get_whose();     // The color on move.
@@ -268,8 +1110,14 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     //Move null_move;                        // The all-important null move.
     Move m;                                // The best move and score.
 
+    // Until we find a best move, our line is empty.
+    pv_length[depth] = depth;
+
+    // How deep we're to search from here (max_depth, less any reductions).
+    int horizon = max_depth - reduction;
+
     //set the special flag for deeper searches (captures and checks)
-    bool specialFlag = (specialCase && (depth >= (max_depth-SPECIAL_SEARCH_DEPTH)))?true:false;
+    bool specialFlag = (specialCase && (depth >= (horizon-SPECIAL_SEARCH_DEPTH)))?true:false;
 
     // Increment the number of positions searched.
     nodes++;
@@ -302,8 +1150,18 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     // then we are currently requesting, just return the node
     // false means, either we need to search deeper (but best move is still populated)
     // or we haven't seen this position before
-    if (table_ptr->probe(hash, max_depth-depth, EXACT, &m))
+    // (At the root, when we're to search for several lines, the table can only
+    // tell us which move to try first.)
+    if (table_ptr->probe(hash, horizon-depth, &m) &&
+        !(depth == 1 && lines > 1))
+    {
+      if (!m.is_null())
+      {
+        pv_table[depth][depth] = m;
+        pv_length[depth] = depth + 1;
+      }
       return m;
+    }
 
     //  if (table_ptr->probe(hash, depth, UPPER, &m))
 //  {
@@ -327,10 +1185,10 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     // If we've reached the maximum search depth, then this node is a leaf - all
     // we have to do is apply the static evaluator.
     // if the special flag is set, we need to go deeper
-    if ((depth >= max_depth) && (!specialFlag))  //uninteresting leaf node
+    if ((depth >= horizon) && (!specialFlag))  //uninteresting leaf node
     {
         m.set_null();
-        m.value = -board_ptr->evaluate();
+        m.value = -board_ptr->evaluate(-beta, -alpha);
 #ifndef _MSDEV_WINDOWS
         DEBUG_SEARCH_PRINT("evaluate() says %d.", board_ptr->get_whose() ? -m.value : m.value);
 #endif
@@ -338,10 +1196,10 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     }
 
     //this is a leaf node in any case
-    if (depth >= (max_depth+SPECIAL_SEARCH_DEPTH)) //leaf node in any case
+    if (depth >= (horizon+SPECIAL_SEARCH_DEPTH)) //leaf node in any case
     {
         m.set_null();
-        m.value = -board_ptr->evaluate();
+        m.value = -board_ptr->evaluate(-beta, -alpha);
 #ifndef _MSDEV_WINDOWS
         DEBUG_SEARCH_PRINT("evaluate() says %d.", board_ptr->get_whose() ? -m.value : m.value);
 #endif
@@ -366,8 +1224,10 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     }
     */
 
-    // Generate the move list.
-    if (!board_ptr->generate(MoveArrays[depth], false))  //include illegal moves
+    // Generate the move list.  (Include illegal moves, except at the root when
+    // each root move gets its own worker - let's not waste one on them.)
+    bool only_legal = depth == 1 && master->smp_mode == SMP_ROOT;
+    if (!board_ptr->generate(MoveArrays[depth], only_legal))
     {
         // There's a move in the list that captures the opponent's king, which
         // means that we're in an illegal position.
@@ -382,13 +1242,34 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     // Here, m is either a null move, or the best move as discovered
     // from a prior iteration
 
-    // If it matches, set it to VALUE_KING so we look at it first
-    // else, just use the history heuristic
+    // Look up the move that refutes our opponent's last move (if any).
+    Move counter;
+    counter.set_null();
+    if (depth > 1 && !line[depth - 1].is_null())
+    {
+      Move prev = line[depth - 1];
+      counter = countermoves[whose][prev.x1 + 8 * prev.y1][prev.x2 + 8 * prev.y2];
+    }
+
+    // If it matches, set it to ORDER_HASH so we look at it first, then the
+    // killer moves, then the countermove, else, just use the history heuristic
+    // (and the continuation history)
     for (unsigned i=0;i<MoveArrays[depth].mNumElements;++i)
     {
-      MoveArrays[depth].theArray[i].value = 
-        MoveArrays[depth].theArray[i] == m ? VALUE_KING : 
-        history_ptr->probe(whose, MoveArrays[depth].theArray[i]);
+      Move& move = MoveArrays[depth].theArray[i];
+      if (move == m)
+      {
+        move.value = ORDER_HASH;
+        continue;
+      }
+      move.value = !counter.is_null() && move == counter ? ORDER_COUNTER :
+        LESSER(history_score(depth, whose, move), ORDER_COUNTER - 1);
+      for (int slot = 0; slot < KILLER_SLOTS; slot++)
+        if (move == killers[depth][slot])
+        {
+          move.value = ORDER_KILLER - slot;
+          break;
+        }
     }
 
     // sort the move list.
@@ -419,28 +1300,96 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     m.value = -VALUE_ILLEGAL;
     bool capture = false;
     bool check = false;
+    bool in_check = board_ptr->check(true) | board_ptr->check(false); //in check now?
+    Move tried[HISTORY_TRIED];
+    int num_tried = 0;
     for(unsigned i=0;i<MoveArrays[depth].mNumElements;++i)
     {
-        check = board_ptr->check(true) | board_ptr->check(false); //in check now?
+        // Root move parallelism: hand out all of the root moves at once,
+        // each with a full window, and rank them by their exact scores.
+        if (depth == 1 && master->smp_mode == SMP_ROOT &&
+            master->num_threads > 1)
+        {
+            m = split(depth, reduction, 0, alpha, beta, m, in_check, true);
+            alpha = GREATER(alpha, m.value);
+            rank_root_moves();
+            break;
+        }
+
+        // MultiPV: at the root, a move needn't beat the best move so far,
+        // only the worst of the best few.
+        value_t window = depth == 1 && lines > 1 ? multipv_alpha(i) : alpha;
+
+        // The move's ordering value, which we're about to overwrite with its
+        // score, tells us whether it's a hash move, a killer, or a
+        // countermove, or else how good its history is.
+        value_t order = MoveArrays[depth].theArray[i].value;
+
+        check = in_check;
         DEBUG_SEARCH_ADD_MOVE(MoveArrays[depth].theArray[i]);
-        capture = board_ptr->make(MoveArrays[depth].theArray[i]);
+        capture = make(depth, MoveArrays[depth].theArray[i]);
         check = check | board_ptr->check(true) | board_ptr->check(false); //how 'bout now?
-        MoveArrays[depth].theArray[i].value = -minimax(depth + 1, -beta, -alpha, (capture||check)).value;
+
+
+        // Late move reductions: search a quiet, unpromising move a ply
+        // shallower first.  If it fails high anyway, search it again in full.
+        bool reduced = false;
+        if (i >= LMR_MOVES && depth > 1 && horizon - depth >= LMR_DEPTH &&
+            !capture && !check && !MoveArrays[depth].theArray[i].promo &&
+            order <= 0)
+        {
+            MoveArrays[depth].theArray[i].value = -minimax(depth + 1, -beta, -window, (capture||check), true, reduction + 1).value;
+            reduced = MoveArrays[depth].theArray[i].value <= window ||
+                      ABS(MoveArrays[depth].theArray[i].value) == VALUE_ILLEGAL;
+        }
+        if (!reduced)
+            MoveArrays[depth].theArray[i].value = -minimax(depth + 1, -beta, -window, (capture||check), true, reduction).value;
         DEBUG_SEARCH_DEL_MOVE(MoveArrays[depth].theArray[i]);
         board_ptr->unmake();
         if (ABS(MoveArrays[depth].theArray[i].value) == VALUE_ILLEGAL)
             continue;
+        if (depth == 1 && lines > 1)
+            save_root_pv(i, MoveArrays[depth].theArray[i]);
         if (MoveArrays[depth].theArray[i].value > m.value)
         {
           m = MoveArrays[depth].theArray[i];
+          update_pv(depth, m);
           if (m.value > alpha) alpha = m.value;
         }
         //if beta <= alpha, this position can't yield anything better than
         //what we've already searched, so quit
-        if ((beta <= alpha) || (timeout_flag))
+        if (beta <= alpha)
+        {
+            // Remember moves that cause cutoffs; they're likely to cause
+            // cutoffs in sibling positions too.
+            if (!stopped())
+                store_cutoff(depth, horizon, whose,
+                             MoveArrays[depth].theArray[i],
+                             !capture && !MoveArrays[depth].theArray[i].promo,
+                             tried, num_tried);
+            break;
+        }
+        if (num_tried < HISTORY_TRIED)
+            tried[num_tried++] = MoveArrays[depth].theArray[i];
+        if (stopped())
             break;
+
+        // Young Brothers Wait: once the eldest brother has been searched,
+        // his younger brothers can be searched in parallel.
+        if (m.value != -VALUE_ILLEGAL &&
+            i + 1 < MoveArrays[depth].mNumElements && can_split(depth))
+        {
+            m = split(depth, reduction, i + 1, alpha, beta, m, in_check, false,
+                      tried, num_tried);
+            alpha = GREATER(alpha, m.value);
+            break;
+        }
     }
 
+    // MultiPV: rank the root moves (the best few now have exact scores).
+    if (depth == 1 && lines > 1 && !stopped())
+        rank_root_moves();
+
     // if we didn't find any legal moves
     if (m.value == -VALUE_ILLEGAL)
     {
@@ -472,7 +1421,7 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
     }
 
     // Was the search interrupted?
-    if (!timeout_flag)
+    if (!stopped())
     {
         // Nope, the results are complete and reliable.  Save them for progeny.
         if (m.value > saved_alpha && m.value < saved_beta)
@@ -482,8 +1431,8 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
             // interest of robustness.
           //if ((max_depth-depth) > 3)
             //table_ptr->store(hash, max_depth-depth-1, EXACT, m);
-          if (depth < max_depth) //no special branches
-            table_ptr->store(hash, max_depth-depth,EXACT,m);
+          if (depth < horizon) //no special branches
+            table_ptr->store(hash, horizon-depth,EXACT,m);
           //else if (m.value <= saved_alpha)
             //table_ptr->store(hash, max_depth-depth, UPPER, m);
         //}
@@ -491,7 +1440,6 @@ Move search_mtdf::minimax(int depth, value_t alpha, value_t beta,
         //{
           //table_ptr->store(hash, max_depth-depth, LOWER, m);
         }
-        history_ptr->store(whose, m); //this seems like a good move
     }
     
  
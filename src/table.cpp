@@ -25,22 +25,15 @@
 /*----------------------------------------------------------------------------*\
  |                               table::table()                               |
 \*----------------------------------------------------------------------------*/
-table::table(int mb)
+table::table(int mb, bool i, std::string f)
 {
 
-/// Constructor.
+/// Constructor.  If i is set, then spread the buckets across NUMA nodes.  If f
+/// names a file, then back the buckets with it, so that they outlive us.
 
-    try
-    {
-        if ((slots = mb * MB / sizeof(xpos_slot_t)) == 0)
-            throw;
-        data = new xpos_slot_t[(size_t)slots];
-    }
-    catch (...)
-    {
-        // XXX: We should probably do something here.
-    }
-    clear();
+    interleave = i;
+    file = f;
+    allocate(mb);
 
     //successful = 0;
     //semi_successful = 0;
@@ -53,38 +46,170 @@ table::table(int mb)
 \*----------------------------------------------------------------------------*/
 table::~table()
 {
-    delete[] data;
+    release();
 }
 
+/*----------------------------------------------------------------------------*\
+ |                              table::resize()                               |
+\*----------------------------------------------------------------------------*/
+void table::resize(int mb)
+{
+
+/// Throw away the buckets and allocate new, empty ones in the specified size.
+/// (A file-backed table keeps its file - but unless the file happens to be the
+/// new size, it'll be rejected, and we'll fall back to memory - say so, since
+/// its results won't outlive us.)  Only do this while no thread is searching.
+
+    release();
+    allocate(mb);
+    if (!file.empty() && header == NULL)
+        fprintf(stderr, "%d MB transposition table isn't backed by %s\n", mb,
+                file.c_str());
+}
 
 /*----------------------------------------------------------------------------*\
- |                             history::history()                             |
+ |                              table::get_mb()                               |
 \*----------------------------------------------------------------------------*/
-history::history()
+int table::get_mb() const
 {
-  /// Constructor.
-    try
+
+/// Return the size of the buckets (in MB).  This is exactly the size that we
+/// were asked for, so resize() can tell when there's nothing to do.
+
+    return (int) (buckets * sizeof(xpos_bucket_t) / MB);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            table::buckets_for()                            |
+\*----------------------------------------------------------------------------*/
+uint64_t table::buckets_for(int mb)
+{
+
+/// Return the number of buckets that fit in the specified size (in MB).
+
+    return (uint64_t) mb * MB / sizeof(xpos_bucket_t);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             table::allocate()                              |
+\*----------------------------------------------------------------------------*/
+void table::allocate(int mb)
+{
+
+/// Use as many buckets as fit in the specified size.  The buckets come
+/// page-aligned (so each probe touches exactly one cache line) and, where
+/// the OS allows, on huge pages.  They also come zero-filled (that is, empty),
+/// so there's nothing to clear - and the OS only has to find pages for them as
+/// the search touches them.
+
+    buckets = buckets_for(mb);
+    own.generation = own.cleared = own.wiped = 0;
+    header = NULL;
+    gen = &own;
+
+    if (!file.empty() && map_file(buckets))
+        return;
+    data = (xpos_bucket_t *) memory_alloc((size_t) buckets *
+                                          sizeof(xpos_bucket_t), interleave);
+    if (data == NULL)
     {
-        data = new int****[COLORS];
-        for (int color = WHITE; color <= BLACK; color++)
-        {
-            data[color] = new int***[8];
-            for (int x1 = 0; x1 <= 7; x1++)
-            {
-                data[color][x1] = new int**[8];
-                for (int y1 = 0; y1 <= 7; y1++)
-                {
-                    data[color][x1][y1] = new int*[8];
-                    for (int x2 = 0; x2 <= 7; x2++)
-                        data[color][x1][y1][x2] = new int[8];
-                }
-            }
-        }
+        fprintf(stderr, "could not allocate %d MB transposition table\n", mb);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             table::map_file()                              |
+\*----------------------------------------------------------------------------*/
+bool table::map_file(uint64_t buckets)
+{
+
+/// Back the specified number of buckets with our file.  If the file doesn't
+/// exist yet, then create it and write its header.  If it does, then check its
+/// header against our build and share its generations.  Return whether the
+/// file is usable; if not, say why and leave it alone.
+
+    size_t size = XPOS_HEADER_SIZE + (size_t) buckets * sizeof(xpos_bucket_t);
+    bool created = false;
+    char *ptr = (char *) memory_map_file(file.c_str(), size, &created);
+    if (ptr == NULL)
+    {
+        fprintf(stderr, "could not map %s (or it's not %lu bytes); "
+                "using memory instead\n", file.c_str(), (unsigned long) size);
+        return false;
+    }
+
+    xpos_header_t *h = (xpos_header_t *) ptr;
+    if (created)
+    {
+        memcpy(h->magic, XPOS_FILE_MAGIC, sizeof(h->magic));
+        h->version = XPOS_FILE_VERSION;
+        h->bucket_size = sizeof(xpos_bucket_t);
+        h->key_seed = KEY_SEED;
+        h->buckets = buckets;
+        h->generation = h->cleared = h->wiped = 0;
     }
-    catch (...)
+    else if (memcmp(h->magic, XPOS_FILE_MAGIC, sizeof(h->magic)) ||
+             h->version != XPOS_FILE_VERSION ||
+             h->bucket_size != sizeof(xpos_bucket_t) ||
+             h->key_seed != KEY_SEED || h->buckets != buckets)
     {
-        // XXX: We should probably do something here.
+        fprintf(stderr, "%s was written by a different build of Gray Matter; "
+                "using memory instead\n", file.c_str());
+        memory_free(ptr, size);
+        return false;
     }
+
+    header = h;
+    gen = h;
+    data = (xpos_bucket_t *) (ptr + XPOS_HEADER_SIZE);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              table::release()                              |
+\*----------------------------------------------------------------------------*/
+void table::release()
+{
+
+/// Free the buckets (and if they're backed by a file, unmap it along with its
+/// header).
+
+    size_t size = (size_t) buckets * sizeof(xpos_bucket_t);
+    if (header == NULL)
+        memory_free(data, size);
+    else
+        memory_free(header, XPOS_HEADER_SIZE + size);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             table::hashfull()                              |
+\*----------------------------------------------------------------------------*/
+int table::hashfull() const
+{
+
+/// Estimate how full the table is, in permille, from the first few buckets:
+/// how many of their slots the current search has written.
+
+    int sampled = 0, full = 0;
+    for (uint64_t b = 0; b < buckets && sampled < HASHFULL_SAMPLE; b++)
+        for (int j = 0; j < BUCKET_SLOTS; j++, sampled++)
+        {
+            uint64_t d = data[b].slot[j].data;
+            if (slot_live(d) && slot_generation(d) == gen->generation)
+                full++;
+        }
+    return full * 1000 / sampled;
+}
+
+
+/*----------------------------------------------------------------------------*\
+ |                             history::history()                             |
+\*----------------------------------------------------------------------------*/
+history::history()
+{
+  /// Constructor.
+    cont = new int[CONT_PLIES][COLORS][SHAPES * 64][SHAPES * 64];
     clear();
 }
 
@@ -93,21 +218,7 @@ history::history()
 \*----------------------------------------------------------------------------*/
 history::~history()
 {
-    for (int color = WHITE; color <= BLACK; color++)
-    {
-        for (int x1 = 0; x1 <= 7; x1++)
-        {
-            for (int y1 = 0; y1 <= 7; y1++)
-            {
-                for (int x2 = 0; x2 <= 7; x2++)
-                    delete[] data[color][x1][y1][x2];
-                delete[] data[color][x1][y1];
-            }
-            delete[] data[color][x1];
-        }
-        delete[] data[color];
-    }
-    delete[] data;
+    delete[] cont;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -116,14 +227,29 @@ history::~history()
 void history::clear()
 {
 
-/// Clear the history table.
+/// Clear the history and continuation history tables.
+
+    memset(data, 0, sizeof(data));
+    memset(cont, 0, CONT_PLIES * sizeof(*cont));
+}
+
+/*----------------------------------------------------------------------------*\
+ |                               history::age()                               |
+\*----------------------------------------------------------------------------*/
+void history::age()
+{
+
+/// Scale every score down by a quarter, so that what we learn in the next
+/// iteration counts for more than what we learned in earlier ones.
 
     for (int color = WHITE; color <= BLACK; color++)
-        for (int x1 = 0; x1 <= 7; x1++)
-            for (int y1 = 0; y1 <= 7; y1++)
-                for (int x2 = 0; x2 <= 7; x2++)
-                    for (int y2 = 0; y2 <= 7; y2++)
-                        data[color][x1][y1][x2][y2] = 0;
+        for (int from = 0; from < 64; from++)
+            for (int to = 0; to < 64; to++)
+                data[color][from][to] -= data[color][from][to] / 4;
+
+    int *score = &cont[0][0][0][0];
+    for (size_t n = CONT_PLIES * sizeof(*cont) / sizeof(int); n; n--, score++)
+        *score -= *score / 4;
 }
 
 /*----------------------------------------------------------------------------*\
@@ -131,17 +257,10 @@ void history::clear()
 \*----------------------------------------------------------------------------*/
 PawnTable::PawnTable(int mb)
 {
-    try
-    {
-        if ((slots = mb * MB / sizeof(pawn_slot_t)) == 0)
-            throw;
-        data = new pawn_slot_t[(size_t)slots];
-    }
-    catch (...)
-    {
-        // XXX: We should probably do something here.
-    }
-    clear();
+
+/// Constructor.
+
+    allocate(mb);
 
     //successful = 0;
     //unsuccessful = 0;
@@ -153,7 +272,50 @@ PawnTable::PawnTable(int mb)
 \*----------------------------------------------------------------------------*/
 PawnTable::~PawnTable()
 {
-    delete[] data;
+    memory_free(data, size);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            PawnTable::resize()                             |
+\*----------------------------------------------------------------------------*/
+void PawnTable::resize(int mb)
+{
+
+/// Throw away the slots and allocate new, empty ones in the specified size.
+/// Only do this while no thread is evaluating.
+
+    memory_free(data, size);
+    allocate(mb);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            PawnTable::get_mb()                             |
+\*----------------------------------------------------------------------------*/
+int PawnTable::get_mb() const
+{
+
+/// Return the size of the slots (in MB).
+
+    return (int) (size / MB);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                           PawnTable::allocate()                            |
+\*----------------------------------------------------------------------------*/
+void PawnTable::allocate(int mb)
+{
+
+/// Like the transposition table, the pawn table is probed at random, so it too
+/// goes on huge pages where the OS allows, and comes zero-filled.
+
+    size = (size_t) mb * MB;
+    slots = size / sizeof(pawn_slot_t);
+    data = (pawn_slot_t *) memory_alloc(size);
+    if (data == NULL)
+    {
+        fprintf(stderr, "could not allocate %d MB pawn table\n", mb);
+        exit(EXIT_FAILURE);
+    }
 }
 
 /*----------------------------------------------------------------------------*\
@@ -161,11 +323,120 @@ PawnTable::~PawnTable()
 \*----------------------------------------------------------------------------*/
 void PawnTable::clear()
 {
-    for (uint64_t index = 0; index < slots; index++)
+
+/// Empty the slots.
+
+    memory_clear((void *) data, size);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                           EvalTable::EvalTable()                           |
+\*----------------------------------------------------------------------------*/
+EvalTable::EvalTable(int mb)
+{
+
+/// Constructor.
+
+    allocate(mb);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                          EvalTable::~EvalTable()                           |
+\*----------------------------------------------------------------------------*/
+EvalTable::~EvalTable()
+{
+
+/// Destructor.
+
+    memory_free(data, size);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            EvalTable::resize()                             |
+\*----------------------------------------------------------------------------*/
+void EvalTable::resize(int mb)
+{
+
+/// Throw away the slots and allocate new, empty ones in the specified size.
+/// Only do this while no thread is evaluating.
+
+    memory_free(data, size);
+    allocate(mb);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                            EvalTable::get_mb()                             |
+\*----------------------------------------------------------------------------*/
+int EvalTable::get_mb() const
+{
+
+/// Return the size of the slots (in MB).
+
+    return (int) (size / MB);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                           EvalTable::get_hits()                            |
+\*----------------------------------------------------------------------------*/
+uint64_t EvalTable::get_hits() const
+{
+
+/// Return the number of probes that found a previous evaluation.
+
+    return hits;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                          EvalTable::get_misses()                           |
+\*----------------------------------------------------------------------------*/
+uint64_t EvalTable::get_misses() const
+{
+
+/// Return the number of probes that didn't.
+
+    return misses;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                         EvalTable::reset_counts()                          |
+\*----------------------------------------------------------------------------*/
+void EvalTable::reset_counts()
+{
+
+/// Start counting probes afresh (but keep the slots).
+
+    hits = misses = 0;
+}
+
+/*----------------------------------------------------------------------------*\
+ |                           EvalTable::allocate()                            |
+\*----------------------------------------------------------------------------*/
+void EvalTable::allocate(int mb)
+{
+
+/// The eval table is probed at random too, so it goes on huge pages where the
+/// OS allows, and comes zero-filled.  (A zero hash key can't match a real
+/// position, bar a one in 2^64 chance.)
+
+    size = (size_t) mb * MB;
+    slots = size / sizeof(eval_slot_t);
+    data = (eval_slot_t *) memory_alloc(size);
+    if (data == NULL)
     {
-        data[index].hash = 0;
-        data[index].value = -INFINITY;
+        fprintf(stderr, "could not allocate %d MB eval table\n", mb);
+        exit(EXIT_FAILURE);
     }
+    hits = misses = 0;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                             EvalTable::clear()                             |
+\*----------------------------------------------------------------------------*/
+void EvalTable::clear()
+{
 
+/// Empty the slots, and start counting probes afresh.
+
+    memory_clear((void *) data, size);
+    hits = misses = 0;
+}
@@ -20,6 +20,7 @@
  */
 
 #include <time.h>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <iterator>
@@ -27,9 +28,29 @@
 #include "testing.h"
 #include "board_base.h"
 #include "board_heuristic.h"
+#include "library.h"
+#include "table.h"
 
 using namespace std;
 
+#define TABLE_THREADS 8        // Threads hammering the table at once.
+#define TABLE_KEYS    (1 << 16) // Distinct positions they fight over.
+#define TABLE_OPS     2000000  // Stores and probes per thread.
+#define EVAL_PASSES   50       // Times to evaluate the whole corpus.
+
+/// One thread's share of the transposition table stress test.
+typedef struct table_stress
+{
+    table *table_ptr;    ///< The table shared by every thread.
+    bitboard_t *keys;    ///< The hash keys shared by every thread.
+    int seed;            ///< This thread's random number seed.
+    uint64_t hits;       ///< Probes that found their position.
+    uint64_t torn;       ///< Probes that found someone else's data.
+} table_stress_t;
+
+static void *table_stress_start(void *arg);
+static Move table_stress_move(bitboard_t hash);
+
 // Constructor sets test name
 testing::testing(char *test) : test_name(test) 
 {
@@ -48,11 +69,17 @@ void testing::start()
   else if(test_name == "perft8") test_perft(8);
   else if(test_name == "perft9") test_perft(9);
   else if(test_name == "perft10") test_perft(10);
+  else if(test_name == "ptable") test_table();
+  else if(test_name == "pstartup") test_startup();
+  else if(test_name == "peval") test_eval();
   else 
   {
       cerr << "Unknown test: '" << test_name << "'" << endl;
     cerr << "try \"-perft1\" or \"-perft2\", etc. . ." << endl;
     cerr << "Note: we are currently only supporting up to depth 10." << endl;
+    cerr << "try \"-ptable\" to stress the transposition table." << endl;
+    cerr << "try \"-pstartup\" to time the hash tables' startup." << endl;
+    cerr << "try \"-peval\" to time the evaluator." << endl;
   }
   exit(EXIT_SUCCESS);
 }
@@ -179,3 +206,246 @@ void testing::test_perft(int depth)
   }
     exit(EXIT_SUCCESS);
 }
+
+/*----------------------------------------------------------------------------*\
+ |               test_table()                   |
+\*----------------------------------------------------------------------------*/
+// This hammers one small transposition table from several threads at once.
+// Every store of a given position writes the same data, so any probe that
+// matches a position must return exactly that data - anything else means a
+// torn slot got past the table's validation.
+//
+void testing::test_table()
+{
+    table t(1);
+    bitboard_t *keys = new bitboard_t[TABLE_KEYS];
+    thread_t thread[TABLE_THREADS];
+    table_stress_t stress[TABLE_THREADS];
+    uint64_t x = 0x9E3779B97F4A7C15ULL, hits = 0, torn = 0;
+
+    for (int j = 0; j < TABLE_KEYS; j++)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        keys[j] = x;
+    }
+
+    cout << "Stressing the transposition table with " << TABLE_THREADS
+         << " threads..." << endl;
+    double timeStart = clock();
+    for (int j = 0; j < TABLE_THREADS; j++)
+    {
+        stress[j].table_ptr = &t;
+        stress[j].keys = keys;
+        stress[j].seed = j + 1;
+        stress[j].hits = stress[j].torn = 0;
+        thread_create(&thread[j], (entry_t) table_stress_start, &stress[j]);
+    }
+    for (int j = 0; j < TABLE_THREADS; j++)
+    {
+        thread_wait(&thread[j]);
+        hits += stress[j].hits;
+        torn += stress[j].torn;
+    }
+    double timeEnd = clock();
+
+    cout << (uint64_t) TABLE_THREADS * TABLE_OPS << " probes, " << hits
+         << " hits, " << torn << " torn." << endl;
+    cout << "......................................"
+         << (timeEnd - timeStart)/CLOCKS_PER_SEC << " seconds." << endl;
+    cout << (torn ? "Failed!" : "Correct!") << endl;
+    delete[] keys;
+    exit(torn ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/*----------------------------------------------------------------------------*\
+ |               test_startup()                   |
+\*----------------------------------------------------------------------------*/
+// This times how long the default-sized transposition and pawn tables take to
+// become usable - allocated, zeroed, and backed by real memory - the old way
+// (allocate them, then clear them a slot at a time) and the new way (allocate
+// zero-filled pages, which the OS only finds as they're first touched).  The
+// new way doesn't pay for its pages until the search touches them, so to
+// compare like with like, touch every page inside the timed region.  Then it
+// times clearing the transposition table's worth of memory on one thread and
+// on every processor.
+//
+void testing::test_startup()
+{
+    size_t size = XPOS_TABLE_MB * MB;
+    size_t pawn_size = PAWN_TABLE_MB * MB;
+    uint64_t buckets = size / sizeof(xpos_bucket_t);
+    uint64_t pawn_slots = pawn_size / sizeof(pawn_slot_t);
+
+    // The old way.
+    uint64_t time_start = timer_now();
+    xpos_bucket_t *old_data = new xpos_bucket_t[buckets];
+    for (uint64_t j = 0; j < buckets; j++)
+        for (int k = 0; k < BUCKET_SLOTS; k++)
+        {
+            old_data[j].slot[k].check = 0;
+            old_data[j].slot[k].data = 0;
+        }
+    pawn_slot_t *old_pawns = new pawn_slot_t[pawn_slots];
+    for (uint64_t j = 0; j < pawn_slots; j++)
+        memset(&old_pawns[j], 0, sizeof(pawn_slot_t));
+    uint64_t time_old = timer_now();
+    delete[] old_data;
+    delete[] old_pawns;
+    cout << "Old way: hash tables ready after " << time_old - time_start
+         << " ms." << endl;
+
+    // The new way, up to the point where the first search could start...
+    time_start = timer_now();
+    char *new_data = (char *) memory_alloc(size);
+    char *new_pawns = (char *) memory_alloc(pawn_size);
+    uint64_t time_alloc = timer_now();
+
+    // ...and then until the search has touched every page.
+    for (size_t j = 0; j < size; j += 4096)
+        new_data[j] = 0;
+    for (size_t j = 0; j < pawn_size; j += 4096)
+        new_pawns[j] = 0;
+    uint64_t time_new = timer_now();
+    memory_free(new_data, size);
+    memory_free(new_pawns, pawn_size);
+    cout << "New way: hash tables ready after " << time_alloc - time_start
+         << " ms, every page in after " << time_new - time_start << " ms."
+         << endl;
+
+    // Clearing, once every page has been touched.
+    void *data = memory_alloc(size);
+    memset(data, 0xFF, size);
+    time_start = timer_now();
+    memset(data, 0, size);
+    uint64_t time_one = timer_now();
+    memory_clear(data, size);
+    uint64_t time_all = timer_now();
+    memory_free(data, size);
+    cout << "Clearing " << XPOS_TABLE_MB << " MB took " << time_one - time_start
+         << " ms on 1 thread, " << time_all - time_one << " ms on "
+         << thread_cpus() << "." << endl;
+    exit(EXIT_SUCCESS);
+}
+
+/*----------------------------------------------------------------------------*\
+ |               test_eval()                   |
+\*----------------------------------------------------------------------------*/
+// This times the evaluator over the positions in the EPD test suites (run it
+// from the top of the tree), and every position one move away from them.  The
+// eval table is bypassed, so that every evaluation is worked out in full; the
+// pawn table stays on, as it would be in a search.  The checksum of the
+// evaluations should be the same however the evaluator was compiled.
+//
+void testing::test_eval()
+{
+    const char *epd[] = {"arasan12.epd", "bt2630.epd", "ecmgcp.epd",
+                         "eet.epd", "lapuce2.epd", "pet.epd", "wac.epd"};
+    vector<string> fen;
+    vector<uint64_t> positions;
+    board_heuristic *board_ptr = new board_heuristic();
+    MoveArray l(MAX_MOVES_PER_TURN);
+
+    // Read the positions (the first four fields of each EPD line).
+    for (unsigned j = 0; j < sizeof(epd) / sizeof(epd[0]); j++)
+    {
+        string path = string("testFiles/") + epd[j];
+        ifstream file(path.c_str());
+        if (!file)
+        {
+            cerr << "Couldn't open " << path << endl;
+            continue;
+        }
+        string line;
+        while (getline(file, line))
+        {
+            size_t end = 0;
+            for (int field = 0; field < 4 && end != string::npos; field++)
+                end = line.find(' ', end + 1);
+            if (end == string::npos)
+                continue;
+            string position = line.substr(0, end) + " 0 1";
+            if (board_ptr->set_board_fen(position))
+                fen.push_back(position);
+        }
+    }
+    if (fen.empty())
+    {
+        cerr << "No positions to evaluate." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t evaluations = 0, checksum = 0;
+    uint64_t time_start = timer_now();
+    for (int pass = 0; pass < EVAL_PASSES; pass++)
+        for (size_t j = 0; j < fen.size(); j++)
+        {
+            board_ptr->set_board_fen(fen[j]);
+            checksum = checksum * 31 + board_ptr->evaluate_uncached();
+            board_ptr->generate(l, true);
+            for (unsigned k = 0; k < l.mNumElements; k++)
+            {
+                board_ptr->make(l.theArray[k]);
+                checksum = checksum * 31 + board_ptr->evaluate_uncached();
+                board_ptr->unmake();
+            }
+            evaluations += l.mNumElements + 1;
+        }
+    uint64_t time_end = timer_now();
+    uint64_t ms = time_end > time_start ? time_end - time_start : 1;
+
+    cout << fen.size() << " positions, " << evaluations << " evaluations, "
+         << "checksum " << hex << checksum << dec << "." << endl;
+    cout << "......................................"
+         << time_end - time_start << " ms, " << evaluations / ms
+         << " evaluations/ms." << endl;
+    delete board_ptr;
+    exit(EXIT_SUCCESS);
+}
+
+/*----------------------------------------------------------------------------*\
+ |              table_stress_start()                |
+\*----------------------------------------------------------------------------*/
+static void *table_stress_start(void *arg)
+{
+    table_stress_t *s = (table_stress_t *) arg;
+    uint32_t x = s->seed;
+
+    for (int j = 0; j < TABLE_OPS; j++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bitboard_t hash = s->keys[x % TABLE_KEYS];
+        Move m = table_stress_move(hash), found;
+
+        // Store the position half of the time, and probe it every time.
+        if (x & 1 << 20)
+            s->table_ptr->store(hash, hash >> 40 & 31, EXACT, m);
+        s->table_ptr->probe(hash, 0, &found);
+        if (!found.is_null() || found.value)
+        {
+            s->hits++;
+            if (found != m || found.value != m.value)
+                s->torn++;
+        }
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*\
+ |              table_stress_move()                 |
+\*----------------------------------------------------------------------------*/
+static Move table_stress_move(bitboard_t hash)
+{
+    // Derive a (never null) move and its score from a position's hash key.
+    Move m;
+    m.x1 = hash & 7;
+    m.y1 = hash >> 3 & 7;
+    m.x2 = (hash >> 6 & 7) | 1;
+    m.y2 = hash >> 9 & 7;
+    m.promo = hash >> 12 & 7;
+    m.value = (int16_t) (hash >> 16);
+    return m;
+}
@@ -47,6 +47,7 @@ xboard::xboard()
     force = false;
     draw = false;
     sync = true;
+    memory_mb = 0;
 
     // Initialize TestSuite statistics
     ts_mode = false;
@@ -151,6 +152,12 @@ void xboard::loop(search_base *s, chess_clock *c, book *o)
             do_analyze();
         else if (!strncmp(buffer, "exit", 4))
             do_exit();
+        else if (!strncmp(buffer, "cores", 5))
+            do_cores();
+        else if (!strncmp(buffer, "memory", 6))
+            do_memory();
+        else if (!strncmp(buffer, "option", 6))
+            do_option();
 
         // These commands are for Scid, which is slightly different from xboard,
         // note that to use Gray matter you must configure it as an xboard engine (uncheck UCI).
@@ -190,6 +197,64 @@ void xboard::print_output(int ply, int value, int time, int nodes, MoveArray& pv
   printf("\n");
 }
 
+/*----------------------------------------------------------------------------*\
+ |                            print_thread_nodes()                            |
+\*----------------------------------------------------------------------------*/
+void xboard::print_thread_nodes(int threads, const int *nodes) const
+{
+
+/// Print the number of nodes each search thread searched, as a comment (which
+/// XBoard ignores).
+
+    printf("# nodes per thread:");
+    for (int id = 0; id < threads; id++)
+        printf(" %d", nodes[id]);
+    printf("\n");
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             print_root_moves()                             |
+\*----------------------------------------------------------------------------*/
+void xboard::print_root_moves(MoveArray& moves) const
+{
+
+/// Print the ranked root moves and their scores, as a comment (which XBoard
+/// ignores).
+
+    printf("# root moves:");
+    for (unsigned i = 0; i < moves.size(); i++)
+    {
+        printf(" ");
+        print_move(moves.theArray[i]);
+        printf(" %d", moves.theArray[i].value);
+    }
+    printf("\n");
+}
+
+/*----------------------------------------------------------------------------*\
+ |                              print_hashfull()                              |
+\*----------------------------------------------------------------------------*/
+void xboard::print_hashfull(int permille) const
+{
+
+/// Print how full the transposition table is, in permille, as a comment (which
+/// XBoard ignores).
+
+    printf("# hashfull: %d\n", permille);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                             print_eval_hits()                              |
+\*----------------------------------------------------------------------------*/
+void xboard::print_eval_hits(int permille) const
+{
+
+/// Print how many of our evaluations the eval table has answered, in permille,
+/// as a comment (which XBoard ignores).
+
+    printf("# eval hits: %d\n", permille);
+}
+
 /*----------------------------------------------------------------------------*\
  |                               print_result()                               |
 \*----------------------------------------------------------------------------*/
@@ -198,7 +263,9 @@ void xboard::print_result(Move m)
 
 /// We've just finished thinking.  If we came up with a move, update the board
 /// and clock, inform XBoard of the move we're making, and change the move
-/// search engine's mode.
+/// search engine's mode.  (If XBoard changed our memory while we were thinking,
+/// then this is when we resize the hash tables - the search is over, so nothing
+/// is touching them.)
 
     // Did we come up with a move?
     if (m.is_null())
@@ -219,6 +286,13 @@ void xboard::print_result(Move m)
     print_move(m);
     printf("\n");
 
+    // Resize the hash tables, if XBoard asked us to while we were thinking.
+    if (memory_mb)
+    {
+        search_ptr->set_memory(memory_mb);
+        memory_mb = 0;
+    }
+
     // Change the move search engine's mode.
     int status = game_over();
     int mode = ponder && status == IN_PROGRESS ? PONDERING : IDLING;
@@ -306,6 +380,9 @@ void xboard::do_protover() const
 #endif
     printf("feature variants=\"normal\"\n");
     printf("feature colors=0\n");
+    printf("feature smp=1\n");
+    printf("feature memory=1\n");
+    printf("feature option=\"MultiPV -spin 1 1 %d\"\n", MAX_MOVES_PER_TURN);
     printf("feature done=1\n");
 
 }
@@ -335,8 +412,9 @@ void xboard::do_new()
     draw = false;
     sync = true;
     board_ptr->set_board();
-    search_ptr->reset();  //clear hashes and history
     search_ptr->change(IDLING, *board_ptr);
+    search_ptr->wait_idle();
+    search_ptr->reset();  //clear hashes and history
     search_ptr->set_depth(MAX_DEPTH);
     book_ptr->read();
     if (analyze)
@@ -652,6 +730,62 @@ void xboard::do_exit()
     analyze = false;
 }
 
+/*----------------------------------------------------------------------------*\
+ |                                 do_cores()                                 |
+\*----------------------------------------------------------------------------*/
+void xboard::do_cores() const
+{
+
+/// Set the number of search threads (from the next search on).
+
+    search_ptr->set_threads(str_to_num(&buffer[6]));
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                do_memory()                                 |
+\*----------------------------------------------------------------------------*/
+void xboard::do_memory()
+{
+
+/// Resize the hash tables to fit in the specified size (in MB).  The search
+/// thread mustn't touch the tables while we reallocate them.  If we're thinking,
+/// then stopping would make us move early, so leave the resize for when we move
+/// (see print_result()).  Otherwise, stop pondering or analyzing first, then
+/// pick up where we left off.
+
+    int mb = str_to_num(&buffer[7]);
+    if (mb < 1)
+        return;
+    int status = search_ptr->get_status();
+    if (status == THINKING)
+    {
+        memory_mb = mb;
+        return;
+    }
+    search_ptr->change(IDLING, *board_ptr);
+    search_ptr->wait_idle();
+    search_ptr->set_memory(mb);
+    if (status == ANALYZING || status == PONDERING)
+        search_ptr->change(status, *board_ptr);
+}
+
+/*----------------------------------------------------------------------------*\
+ |                                do_option()                                 |
+\*----------------------------------------------------------------------------*/
+void xboard::do_option()
+{
+
+/// Set one of the engine-defined options (the ones we've announced with
+/// "feature option").
+
+    if (!strncmp(&buffer[7], "MultiPV=", 8))
+    {
+        search_ptr->set_multipv(str_to_num(&buffer[15]));
+        if (analyze)
+            search_ptr->change(ANALYZING, *board_ptr);
+    }
+}
+
 /*----------------------------------------------------------------------------*\
  |                                do_display()                                |
 \*----------------------------------------------------------------------------*/